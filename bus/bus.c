@@ -6,6 +6,7 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/idr.h>
+#include <linux/mutex.h>
 #include <linux/version.h>
 
 #include "bus.h"
@@ -16,6 +17,29 @@
 
 static DEFINE_IDA(gip_adapter_ida);
 
+/* serializes updates of the static calls */
+static DEFINE_MUTEX(gip_dispatch_lock);
+
+#ifdef GIP_STATIC_CALL
+DEFINE_STATIC_CALL(gip_get_buffer, gip_adapter_get_buffer);
+DEFINE_STATIC_CALL(gip_submit_buffer, gip_adapter_submit_buffer);
+DEFINE_STATIC_CALL(gip_battery, gip_driver_battery);
+DEFINE_STATIC_CALL(gip_input, gip_driver_input);
+DEFINE_STATIC_CALL(gip_audio_samples, gip_driver_audio_samples);
+#endif
+
+struct gip_dispatch_state {
+	struct gip_adapter_ops *adap_ops;
+	bool adap_mixed;
+
+	struct gip_driver *drv_battery;
+	struct gip_driver *drv_input;
+	struct gip_driver *drv_audio_samples;
+	int num_battery;
+	int num_input;
+	int num_audio_samples;
+};
+
 static void gip_adapter_release(struct device *dev)
 {
 	kfree(to_gip_adapter(dev));
@@ -49,11 +73,8 @@ static void gip_remove_client(struct gip_client *client)
 	put_device(&client->dev);
 }
 
-static void gip_client_state_changed(struct work_struct *work)
+static void gip_client_state_changed(struct gip_client *client)
 {
-	struct gip_client *client = container_of(work, typeof(*client),
-						 state_work);
-
 	switch (atomic_read(&client->state)) {
 	case GIP_CL_IDENTIFIED:
 		gip_add_client(client);
@@ -67,6 +88,43 @@ static void gip_client_state_changed(struct work_struct *work)
 	}
 }
 
+static void gip_adapter_state_work(struct work_struct *work)
+{
+	struct gip_adapter *adap = container_of(work, typeof(*adap),
+						state_work);
+	struct gip_client *client;
+	unsigned long flags;
+
+	/* work items are non-reentrant, state changes are handled in order */
+	for (;;) {
+		spin_lock_irqsave(&adap->state_lock, flags);
+		client = list_first_entry_or_null(&adap->state_list,
+						   typeof(*client), state_node);
+		if (client)
+			list_del_init(&client->state_node);
+		spin_unlock_irqrestore(&adap->state_lock, flags);
+
+		if (!client)
+			break;
+
+		gip_client_state_changed(client);
+	}
+}
+
+static void gip_queue_state_change(struct gip_client *client)
+{
+	struct gip_adapter *adap = client->adapter;
+	unsigned long flags;
+
+	/* pending state changes are coalesced */
+	spin_lock_irqsave(&adap->state_lock, flags);
+	if (list_empty(&client->state_node))
+		list_add_tail(&client->state_node, &adap->state_list);
+	spin_unlock_irqrestore(&adap->state_lock, flags);
+
+	queue_work(system_wq, &adap->state_work);
+}
+
 static int gip_client_uevent(struct device *dev, struct kobj_uevent_env *env)
 {
 	struct gip_client *client = to_gip_client(dev);
@@ -168,6 +226,129 @@ static struct bus_type gip_bus_type = {
 #endif
 };
 
+int gip_adapter_get_buffer(struct gip_adapter *adap,
+			   struct gip_adapter_buffer *buf)
+{
+	return adap->ops->get_buffer(adap, buf);
+}
+
+int gip_adapter_submit_buffer(struct gip_adapter *adap,
+			      struct gip_adapter_buffer *buf)
+{
+	return adap->ops->submit_buffer(adap, buf);
+}
+
+int gip_driver_battery(struct gip_client *client,
+		       enum gip_battery_type type,
+		       enum gip_battery_level level)
+{
+	return client->drv->ops.battery(client, type, level);
+}
+
+int gip_driver_input(struct gip_client *client, void *data, u32 len)
+{
+	return client->drv->ops.input(client, data, len);
+}
+
+int gip_driver_audio_samples(struct gip_client *client, void *data, u32 len)
+{
+	return client->drv->ops.audio_samples(client, data, len);
+}
+
+static int gip_dispatch_add_adapter(struct device *dev, void *data)
+{
+	struct gip_dispatch_state *state = data;
+	struct gip_adapter *adap;
+
+	if (dev->type != &gip_adapter_type)
+		return 0;
+
+	adap = to_gip_adapter(dev);
+	if (state->adap_ops && state->adap_ops != adap->ops)
+		state->adap_mixed = true;
+
+	state->adap_ops = adap->ops;
+
+	return 0;
+}
+
+static int gip_dispatch_add_driver(struct device_driver *driver, void *data)
+{
+	struct gip_dispatch_state *state = data;
+	struct gip_driver *drv = to_gip_driver(driver);
+
+	if (drv->ops.battery) {
+		state->drv_battery = drv;
+		state->num_battery++;
+	}
+
+	if (drv->ops.input) {
+		state->drv_input = drv;
+		state->num_input++;
+	}
+
+	if (drv->ops.audio_samples) {
+		state->drv_audio_samples = drv;
+		state->num_audio_samples++;
+	}
+
+	return 0;
+}
+
+/*
+ * Calls on the hot path are dispatched directly if all adapters share the
+ * same transport and only a single driver implements the operation. The
+ * targets are updated before a new adapter or driver becomes visible.
+ */
+static void gip_update_dispatch(struct gip_adapter *new_adap,
+				struct gip_driver *new_drv)
+{
+#ifdef GIP_STATIC_CALL
+	struct gip_dispatch_state state = {};
+
+	lockdep_assert_held(&gip_dispatch_lock);
+
+	if (new_adap)
+		gip_dispatch_add_adapter(&new_adap->dev, &state);
+
+	if (new_drv)
+		gip_dispatch_add_driver(&new_drv->drv, &state);
+
+	bus_for_each_dev(&gip_bus_type, NULL, &state,
+			 gip_dispatch_add_adapter);
+	bus_for_each_drv(&gip_bus_type, NULL, &state,
+			 gip_dispatch_add_driver);
+
+	if (state.adap_ops && !state.adap_mixed) {
+		static_call_update(gip_get_buffer, state.adap_ops->get_buffer);
+		static_call_update(gip_submit_buffer,
+				   state.adap_ops->submit_buffer);
+	} else {
+		static_call_update(gip_get_buffer, gip_adapter_get_buffer);
+		static_call_update(gip_submit_buffer,
+				   gip_adapter_submit_buffer);
+	}
+
+	if (state.num_battery == 1)
+		static_call_update(gip_battery,
+				   state.drv_battery->ops.battery);
+	else
+		static_call_update(gip_battery, gip_driver_battery);
+
+	if (state.num_input == 1)
+		static_call_update(gip_input, state.drv_input->ops.input);
+	else
+		static_call_update(gip_input, gip_driver_input);
+
+	if (state.num_audio_samples == 1)
+		static_call_update(gip_audio_samples,
+				   state.drv_audio_samples->ops.audio_samples);
+	else
+		static_call_update(gip_audio_samples,
+				   gip_driver_audio_samples);
+#endif
+}
+
 struct gip_adapter *gip_create_adapter(struct device *parent,
 				       struct gip_adapter_ops *ops,
 				       int audio_pkts)
@@ -185,12 +366,6 @@ struct gip_adapter *gip_create_adapter(struct device *parent,
 		goto err_put_device;
 	}
 
-	adap->state_queue = alloc_ordered_workqueue("gip%d", 0, adap->id);
-	if (!adap->state_queue) {
-		err = -ENOMEM;
-		goto err_remove_ida;
-	}
-
 	adap->dev.parent = parent;
 	adap->dev.type = &gip_adapter_type;
 	adap->dev.bus = &gip_bus_type;
@@ -199,17 +374,24 @@ struct gip_adapter *gip_create_adapter(struct device *parent,
 	dev_set_name(&adap->dev, "gip%d", adap->id);
 	spin_lock_init(&adap->clients_lock);
 	spin_lock_init(&adap->send_lock);
+	spin_lock_init(&adap->state_lock);
+	INIT_LIST_HEAD(&adap->state_list);
+	INIT_WORK(&adap->state_work, gip_adapter_state_work);
 
+	mutex_lock(&gip_dispatch_lock);
+	gip_update_dispatch(adap, NULL);
 	err = device_register(&adap->dev);
 	if (err)
-		goto err_destroy_queue;
+		gip_update_dispatch(NULL, NULL);
+	mutex_unlock(&gip_dispatch_lock);
+
+	if (err)
+		goto err_remove_ida;
 
 	dev_dbg(&adap->dev, "%s: registered\n", __func__);
 
 	return adap;
 
-err_destroy_queue:
-	destroy_workqueue(adap->state_queue);
 err_remove_ida:
 	ida_simple_remove(&gip_adapter_ida, adap->id);
 err_put_device:
@@ -237,7 +419,7 @@ void gip_destroy_adapter(struct gip_adapter *adap)
 	int i;
 
 	/* ensure all state changes have been processed */
-	flush_workqueue(adap->state_queue);
+	flush_work(&adap->state_work);
 
 	for (i = GIP_MAX_CLIENTS - 1; i >= 0; i--) {
 		client = adap->clients[i];
@@ -249,10 +431,13 @@ void gip_destroy_adapter(struct gip_adapter *adap)
 	}
 
 	ida_simple_remove(&gip_adapter_ida, adap->id);
-	destroy_workqueue(adap->state_queue);
 
 	dev_dbg(&adap->dev, "%s: unregistered\n", __func__);
+
+	mutex_lock(&gip_dispatch_lock);
 	device_unregister(&adap->dev);
+	gip_update_dispatch(NULL, NULL);
+	mutex_unlock(&gip_dispatch_lock);
 }
 EXPORT_SYMBOL_GPL(gip_destroy_adapter);
 
@@ -272,7 +457,7 @@ static struct gip_client *gip_init_client(struct gip_adapter *adap, u8 id)
 	dev_set_name(&client->dev, "gip%d.%u", adap->id, client->id);
 	atomic_set(&client->state, GIP_CL_CONNECTED);
 	spin_lock_init(&client->lock);
-	INIT_WORK(&client->state_work, gip_client_state_changed);
+	INIT_LIST_HEAD(&client->state_node);
 
 	device_initialize(&client->dev);
 	dev_dbg(&client->dev, "%s: initialized\n", __func__);
@@ -312,7 +497,7 @@ void gip_put_client(struct gip_client *client)
 void gip_register_client(struct gip_client *client)
 {
 	atomic_set(&client->state, GIP_CL_IDENTIFIED);
-	queue_work(client->adapter->state_queue, &client->state_work);
+	gip_queue_state_change(client);
 }
 
 void gip_unregister_client(struct gip_client *client)
@@ -325,7 +510,7 @@ void gip_unregister_client(struct gip_client *client)
 	spin_unlock_irqrestore(&adap->clients_lock, flags);
 
 	atomic_set(&client->state, GIP_CL_DISCONNECTED);
-	queue_work(adap->state_queue, &client->state_work);
+	gip_queue_state_change(client);
 }
 
 void gip_free_client_info(struct gip_client *client)
@@ -358,18 +543,30 @@ void gip_free_client_info(struct gip_client *client)
 int __gip_register_driver(struct gip_driver *drv, struct module *owner,
 			  const char *mod_name)
 {
+	int err;
+
 	drv->drv.name = drv->name;
 	drv->drv.bus = &gip_bus_type;
 	drv->drv.owner = owner;
 	drv->drv.mod_name = mod_name;
 
-	return driver_register(&drv->drv);
+	mutex_lock(&gip_dispatch_lock);
+	gip_update_dispatch(NULL, drv);
+	err = driver_register(&drv->drv);
+	if (err)
+		gip_update_dispatch(NULL, NULL);
+	mutex_unlock(&gip_dispatch_lock);
+
+	return err;
 }
 EXPORT_SYMBOL_GPL(__gip_register_driver);
 
 void gip_unregister_driver(struct gip_driver *drv)
 {
+	mutex_lock(&gip_dispatch_lock);
 	driver_unregister(&drv->drv);
+	gip_update_dispatch(NULL, NULL);
+	mutex_unlock(&gip_dispatch_lock);
 }
 EXPORT_SYMBOL_GPL(gip_unregister_driver);
 
@@ -7,6 +7,12 @@
 
 #include <linux/types.h>
 #include <linux/device.h>
+#include <linux/version.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+#include <linux/static_call.h>
+#define GIP_STATIC_CALL
+#endif
 
 #include "protocol.h"
 
@@ -34,6 +40,8 @@ struct gip_adapter_ops {
 			  struct gip_adapter_buffer *buf);
 	int (*submit_buffer)(struct gip_adapter *adap,
 			     struct gip_adapter_buffer *buf);
+	void (*release_buffer)(struct gip_adapter *adap,
+			       struct gip_adapter_buffer *buf);
 	int (*enable_audio)(struct gip_adapter *adap);
 	int (*init_audio_in)(struct gip_adapter *adap);
 	int (*init_audio_out)(struct gip_adapter *adap, int pkt_len);
@@ -44,33 +52,35 @@ struct gip_adapter {
 	struct device dev;
 	int id;
 
-	struct gip_adapter_ops *ops;
-	int audio_packet_count;
-
-	struct gip_client *clients[GIP_MAX_CLIENTS];
-	struct workqueue_struct *state_queue;
+	/* serializes access to state change list */
+	spinlock_t state_lock;
+	struct list_head state_list;
+	struct work_struct state_work;
 
-	/* serializes access to clients array */
-	spinlock_t clients_lock;
+	/* transmit path */
+	struct gip_adapter_ops *ops ____cacheline_aligned_in_smp;
+	int audio_packet_count;
 
 	/* serializes access to data sequence number */
 	spinlock_t send_lock;
 
 	u8 data_sequence;
 	u8 audio_sequence;
+
+	/* playback pacing, maintained by the transport */
+	int audio_depth;
+	atomic_t audio_pending;
+	u32 audio_interval;
+
+	/* receive path, serializes access to clients array */
+	spinlock_t clients_lock ____cacheline_aligned_in_smp;
+	struct gip_client *clients[GIP_MAX_CLIENTS];
 };
 
 struct gip_client {
 	struct device dev;
-	u8 id;
-	atomic_t state;
 
-	struct gip_adapter *adapter;
-	struct gip_driver *drv;
-
-	struct gip_chunk_buffer *chunk_buf;
 	struct gip_hardware hardware;
-
 	struct gip_info_element *external_commands;
 	struct gip_info_element *firmware_versions;
 	struct gip_info_element *audio_formats;
@@ -81,11 +91,18 @@ struct gip_client {
 	struct gip_info_element *hid_descriptor;
 
 	struct gip_audio_config audio_config_in;
-	struct gip_audio_config audio_config_out;
+	struct list_head state_node;
 
-	/* serializes packet processing */
-	spinlock_t lock;
-	struct work_struct state_work;
+	/* packet path, serializes packet processing */
+	spinlock_t lock ____cacheline_aligned_in_smp;
+	atomic_t state;
+	u8 id;
+
+	struct gip_adapter *adapter;
+	struct gip_driver *drv;
+	struct gip_chunk_buffer *chunk_buf;
+
+	struct gip_audio_config audio_config_out;
 };
 
 struct gip_driver_ops {
@@ -126,3 +143,31 @@ void gip_free_client_info(struct gip_client *client);
 int __gip_register_driver(struct gip_driver *drv, struct module *owner,
 			  const char *mod_name);
 void gip_unregister_driver(struct gip_driver *drv);
+
+/* indirect dispatch, used if multiple transports or drivers are active */
+int gip_adapter_get_buffer(struct gip_adapter *adap,
+			   struct gip_adapter_buffer *buf);
+int gip_adapter_submit_buffer(struct gip_adapter *adap,
+			      struct gip_adapter_buffer *buf);
+int gip_driver_battery(struct gip_client *client,
+		       enum gip_battery_type type,
+		       enum gip_battery_level level);
+int gip_driver_input(struct gip_client *client, void *data, u32 len);
+int gip_driver_audio_samples(struct gip_client *client, void *data, u32 len);
+
+#ifdef GIP_STATIC_CALL
+DECLARE_STATIC_CALL(gip_get_buffer, gip_adapter_get_buffer);
+DECLARE_STATIC_CALL(gip_submit_buffer, gip_adapter_submit_buffer);
+DECLARE_STATIC_CALL(gip_battery, gip_driver_battery);
+DECLARE_STATIC_CALL(gip_input, gip_driver_input);
+DECLARE_STATIC_CALL(gip_audio_samples, gip_driver_audio_samples);
+
+#define gip_call(name, ...) static_call(gip_##name)(__VA_ARGS__)
+#else
+#define gip_call(name, ...) gip_call_##name(__VA_ARGS__)
+#define gip_call_get_buffer gip_adapter_get_buffer
+#define gip_call_submit_buffer gip_adapter_submit_buffer
+#define gip_call_battery gip_driver_battery
+#define gip_call_input gip_driver_input
+#define gip_call_audio_samples gip_driver_audio_samples
+#endif
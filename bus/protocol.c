@@ -314,7 +314,7 @@ static int gip_send_pkt(struct gip_client *client,
 
 	spin_lock_irqsave(&adap->send_lock, flags);
 
-	err = adap->ops->get_buffer(adap, &buf);
+	err = gip_call(get_buffer, adap, &buf);
 	if (err) {
 		dev_err(&client->dev, "%s: get buffer failed: %d\n",
 			__func__, err);
@@ -323,6 +323,10 @@ static int gip_send_pkt(struct gip_client *client,
 
 	hdr_len = gip_get_header_length(hdr);
 	if (buf.length < hdr_len + hdr->packet_length) {
+		/* return the unused buffer to the transport */
+		if (adap->ops->release_buffer)
+			adap->ops->release_buffer(adap, &buf);
+
 		err = -ENOSPC;
 		goto err_unlock;
 	}
@@ -339,7 +343,7 @@ static int gip_send_pkt(struct gip_client *client,
 	buf.length = hdr_len + hdr->packet_length;
 
 	/* always fails on adapter removal */
-	err = adap->ops->submit_buffer(adap, &buf);
+	err = gip_call(submit_buffer, adap, &buf);
 	if (err)
 		dev_dbg(&client->dev, "%s: submit buffer failed: %d\n",
 			__func__, err);
@@ -558,12 +562,28 @@ EXPORT_SYMBOL_GPL(gip_set_led_rgb);
 
 
 
+static void gip_copy_audio_fragment(void *dest, void *ring, size_t size,
+				    size_t pos, int len)
+{
+	size_t remaining = size - pos;
+
+	if (!ring) {
+		memset(dest, 0, len);
+	} else if (len <= remaining) {
+		memcpy(dest, ring + pos, len);
+	} else {
+		memcpy(dest, ring + pos, remaining);
+		memcpy(dest + remaining, ring, len - remaining);
+	}
+}
+
 static void gip_copy_audio_samples(struct gip_client *client,
-				   void *samples, void *buf)
+				   void *ring, size_t size, size_t pos,
+				   void *buf)
 {
 	struct gip_audio_config *cfg = &client->audio_config_out;
 	struct gip_header hdr = {};
-	void *src, *dest;
+	void *dest;
 	int hdr_len, i;
 
 	hdr.command = GIP_CMD_AUDIO_SAMPLES;
@@ -573,7 +593,6 @@ static void gip_copy_audio_samples(struct gip_client *client,
 	hdr_len = gip_get_header_length(&hdr);
 
 	for (i = 0; i < client->adapter->audio_packet_count; i++) {
-		src = samples + i * cfg->fragment_size;
 		dest = buf + i * cfg->packet_size;
 
 		/* sequence number is always greater than zero */
@@ -582,11 +601,21 @@ static void gip_copy_audio_samples(struct gip_client *client,
 		} while (!hdr.sequence);
 
 		gip_encode_header(&hdr, dest);
-		memcpy(dest + hdr_len, src, cfg->fragment_size);
+		gip_copy_audio_fragment(dest + hdr_len, ring, size, pos,
+					cfg->fragment_size);
+
+		pos += cfg->fragment_size;
+		if (pos >= size)
+			pos -= size;
 	}
 }
 
-int gip_send_audio_samples(struct gip_client *client, void *samples)
+/*
+ * Frames samples directly from a ring buffer into the transport buffer.
+ * Sends silence if no ring buffer is specified.
+ */
+int gip_send_audio_samples(struct gip_client *client,
+			   void *ring, size_t size, size_t pos)
 {
 	struct gip_adapter *adap = client->adapter;
 	struct gip_adapter_buffer buf = {};
@@ -595,21 +624,21 @@ int gip_send_audio_samples(struct gip_client *client, void *samples)
 	buf.type = GIP_BUF_AUDIO;
 
 	/* returns ENOSPC if no buffer is available */
-	err = adap->ops->get_buffer(adap, &buf);
+	err = gip_call(get_buffer, adap, &buf);
 	if (err) {
 		dev_err(&client->dev, "%s: get buffer failed: %d\n",
 			__func__, err);
 		return err;
 	}
 
-	gip_copy_audio_samples(client, samples, buf.data);
+	gip_copy_audio_samples(client, ring, size, pos, buf.data);
 
 	/* set actual length */
 	buf.length = client->audio_config_out.packet_size *
 		     adap->audio_packet_count;
 
 	/* always fails on adapter removal */
-	err = adap->ops->submit_buffer(adap, &buf);
+	err = gip_call(submit_buffer, adap, &buf);
 	if (err)
 		dev_dbg(&client->dev, "%s: submit buffer failed: %d\n",
 			__func__, err);
@@ -684,6 +713,27 @@ void gip_disable_audio(struct gip_client *client)
 }
 EXPORT_SYMBOL_GPL(gip_disable_audio);
 
+int gip_get_audio_deficit(struct gip_client *client)
+{
+	struct gip_adapter *adap = client->adapter;
+
+	/* number of buffers missing to reach the pipeline depth */
+	return READ_ONCE(adap->audio_depth) - atomic_read(&adap->audio_pending);
+}
+EXPORT_SYMBOL_GPL(gip_get_audio_deficit);
+
+ktime_t gip_get_audio_interval(struct gip_client *client)
+{
+	u32 interval = READ_ONCE(client->adapter->audio_interval);
+
+	/* consumption rate measured by the transport (in ns) */
+	if (interval)
+		return ns_to_ktime(interval);
+
+	return ms_to_ktime(GIP_AUDIO_INTERVAL);
+}
+EXPORT_SYMBOL_GPL(gip_get_audio_interval);
+
 static int gip_make_audio_config(struct gip_client *client,
 				 struct gip_audio_config *cfg)
 {
@@ -1025,9 +1075,9 @@ static int gip_handle_pkt_status(struct gip_client *client,
 	if (!client->drv || !client->drv->ops.battery)
 		return 0;
 
-	return client->drv->ops.battery(client,
-					FIELD_GET(GIP_BATT_TYPE, pkt->status),
-					FIELD_GET(GIP_BATT_LEVEL, pkt->status));
+	return gip_call(battery, client,
+			FIELD_GET(GIP_BATT_TYPE, pkt->status),
+			FIELD_GET(GIP_BATT_LEVEL, pkt->status));
 }
 
 static int gip_handle_pkt_identify(struct gip_client *client,
@@ -1237,7 +1287,7 @@ static int gip_handle_pkt_input(struct gip_client *client,
 	if (!client->drv || !client->drv->ops.input)
 		return 0;
 
-	return client->drv->ops.input(client, data, len);
+	return gip_call(input, client, data, len);
 }
 
 static int gip_handle_pkt_audio_samples(struct gip_client *client,
@@ -1251,8 +1301,8 @@ static int gip_handle_pkt_audio_samples(struct gip_client *client,
 	if (!client->drv || !client->drv->ops.audio_samples)
 		return 0;
 
-	return client->drv->ops.audio_samples(client, pkt->samples,
-					      len - sizeof(*pkt));
+	return gip_call(audio_samples, client, pkt->samples,
+			len - sizeof(*pkt));
 }
 
 static int gip_dispatch_pkt(struct gip_client *client,
@@ -1414,3 +1464,15 @@ int gip_process_buffer(struct gip_adapter *adap, void *data, int len)
 	return 0;
 }
 EXPORT_SYMBOL_GPL(gip_process_buffer);
+
+bool gip_is_audio_packet(void *data, int len)
+{
+	u8 *hdr = data;
+
+	/* transports can release audio samples at a steady rate */
+	if (len <= GIP_HDR_MIN_LENGTH)
+		return false;
+
+	return hdr[0] == GIP_CMD_AUDIO_SAMPLES && (hdr[1] & GIP_OPT_INTERNAL);
+}
+EXPORT_SYMBOL_GPL(gip_is_audio_packet);
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <linux/types.h>
+#include <linux/ktime.h>
 
 /* time between audio packets in ms */
 #define GIP_AUDIO_INTERVAL 8
@@ -104,11 +105,15 @@ int gip_send_rumble(struct gip_client *client, void *pkt, u32 len);
 int gip_set_led_mode(struct gip_client *client,
 		     enum gip_led_mode mode, u8 brightness);
 int gip_set_led_rgb(struct gip_client *client, uint8_t red, uint8_t green, uint8_t blue);
-int gip_send_audio_samples(struct gip_client *client, void *samples);
+int gip_send_audio_samples(struct gip_client *client,
+			   void *ring, size_t size, size_t pos);
 
 int gip_enable_audio(struct gip_client *client);
 int gip_init_audio_in(struct gip_client *client);
 int gip_init_audio_out(struct gip_client *client);
 void gip_disable_audio(struct gip_client *client);
+int gip_get_audio_deficit(struct gip_client *client);
+ktime_t gip_get_audio_interval(struct gip_client *client);
 
 int gip_process_buffer(struct gip_adapter *adap, void *data, int len);
+bool gip_is_audio_packet(void *data, int len);
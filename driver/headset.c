@@ -37,7 +37,6 @@ struct gip_headset {
 	bool registered;
 
 	struct hrtimer timer;
-	void *buffer;
 
 	struct gip_headset_stream {
 		struct snd_pcm_substream *substream;
@@ -119,10 +118,6 @@ static int gip_headset_pcm_trigger(struct snd_pcm_substream *sub, int cmd)
 		return -EINVAL;
 	}
 
-	if (!stream->substream && sub->stream == SNDRV_PCM_STREAM_PLAYBACK)
-		memset(headset->buffer, 0,
-		       headset->client->audio_config_out.buffer_size);
-
 	return 0;
 }
 
@@ -169,23 +164,6 @@ static bool gip_headset_advance_pointer(struct gip_headset_stream *stream,
 	return false;
 }
 
-static bool gip_headset_copy_playback(struct gip_headset_stream *stream,
-				      unsigned char *data, int len)
-{
-	unsigned char *src = stream->substream->runtime->dma_area;
-	size_t buf_size = snd_pcm_lib_buffer_bytes(stream->substream);
-	size_t remaining = buf_size - stream->pointer;
-
-	if (len <= remaining) {
-		memcpy(data, src + stream->pointer, len);
-	} else {
-		memcpy(data, src + stream->pointer, remaining);
-		memcpy(data + remaining, src, len - remaining);
-	}
-
-	return gip_headset_advance_pointer(stream, len, buf_size);
-}
-
 static bool gip_headset_copy_capture(struct gip_headset_stream *stream,
 				     unsigned char *data, int len)
 {
@@ -203,37 +181,64 @@ static bool gip_headset_copy_capture(struct gip_headset_stream *stream,
 	return gip_headset_advance_pointer(stream, len, buf_size);
 }
 
-static enum hrtimer_restart gip_headset_send_samples(struct hrtimer *timer)
+static int gip_headset_send_buffer(struct gip_headset *headset)
 {
-	struct gip_headset *headset = container_of(timer, typeof(*headset),
-						   timer);
 	struct gip_headset_stream *stream = &headset->playback;
 	struct gip_audio_config *cfg = &headset->client->audio_config_out;
 	struct snd_pcm_substream *sub = stream->substream;
+	size_t buf_size;
 	bool elapsed = false;
 	int err;
 	unsigned long flags;
 
-	if (sub) {
-		snd_pcm_stream_lock_irqsave(sub, flags);
-
-		if (sub->runtime && snd_pcm_running(sub))
-			elapsed = gip_headset_copy_playback(stream,
-							    headset->buffer,
-							    cfg->buffer_size);
+	/* send silence if playback is stopped */
+	if (!sub)
+		return gip_send_audio_samples(headset->client, NULL, 0, 0);
 
-		snd_pcm_stream_unlock_irqrestore(sub, flags);
+	snd_pcm_stream_lock_irqsave(sub, flags);
 
-		if (elapsed)
-			snd_pcm_period_elapsed(sub);
+	if (sub->runtime && snd_pcm_running(sub)) {
+		buf_size = snd_pcm_lib_buffer_bytes(sub);
+
+		/* samples are framed directly from the DMA area */
+		err = gip_send_audio_samples(headset->client,
+					     sub->runtime->dma_area,
+					     buf_size, stream->pointer);
+		if (!err)
+			elapsed = gip_headset_advance_pointer(stream,
+							      cfg->buffer_size,
+							      buf_size);
+	} else {
+		err = gip_send_audio_samples(headset->client, NULL, 0, 0);
 	}
 
+	snd_pcm_stream_unlock_irqrestore(sub, flags);
+
+	if (elapsed)
+		snd_pcm_period_elapsed(sub);
+
+	return err;
+}
+
+static enum hrtimer_restart gip_headset_send_samples(struct hrtimer *timer)
+{
+	struct gip_headset *headset = container_of(timer, typeof(*headset),
+						   timer);
+	int count, err;
+
+	/* refill the pipeline after an underrun */
+	count = max(gip_get_audio_deficit(headset->client), 1);
+
+	do {
+		err = gip_headset_send_buffer(headset);
+	} while (!err && --count);
+
 	/* retry if driver runs out of buffers */
-	err = gip_send_audio_samples(headset->client, headset->buffer);
 	if (err && err != -ENOSPC)
 		return HRTIMER_NORESTART;
 
-	hrtimer_forward_now(timer, ms_to_ktime(GIP_AUDIO_INTERVAL));
+	/* follow the rate at which the device consumes samples */
+	hrtimer_forward_now(timer, gip_get_audio_interval(headset->client));
 
 	return HRTIMER_RESTART;
 }
@@ -260,7 +265,6 @@ static int gip_headset_init_card(struct gip_headset *headset)
 
 static int gip_headset_init_pcm(struct gip_headset *headset)
 {
-	struct gip_client *client = headset->client;
 	struct snd_pcm *pcm;
 	int err;
 
@@ -274,12 +278,6 @@ static int gip_headset_init_pcm(struct gip_headset *headset)
 	snd_pcm_set_ops(pcm, SNDRV_PCM_STREAM_PLAYBACK, &gip_headset_pcm_ops);
 	snd_pcm_set_ops(pcm, SNDRV_PCM_STREAM_CAPTURE, &gip_headset_pcm_ops);
 
-	headset->buffer = devm_kzalloc(&client->dev,
-				       client->audio_config_out.buffer_size,
-				       GFP_KERNEL);
-	if (!headset->buffer)
-		return -ENOMEM;
-
 	headset->pcm = pcm;
 
 	return snd_card_register(headset->card);
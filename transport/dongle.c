@@ -7,34 +7,116 @@
 #include <linux/slab.h>
 #include <linux/bitfield.h>
 #include <linux/usb.h>
+#include <linux/sysfs.h>
+#include <linux/hrtimer.h>
+#include <linux/kref.h>
+#include <linux/rcupdate.h>
+#include <linux/average.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/etherdevice.h>
 #include <linux/ieee80211.h>
 #include <net/cfg80211.h>
 
 #include "mt76.h"
 #include "../bus/bus.h"
 
+#define CREATE_TRACE_POINTS
+#include "dongle_trace.h"
+
 #define XONE_DONGLE_NUM_IN_URBS 12
-#define XONE_DONGLE_NUM_OUT_URBS 12
+#define XONE_DONGLE_NUM_OUT_URBS 32
+#define XONE_DONGLE_MAX_TX_INFLIGHT 12
 
 #define XONE_DONGLE_LEN_CMD_PKT 0x0654
 #define XONE_DONGLE_LEN_WLAN_PKT 0x8400
 
+/* command header + WCID data + TXWI + QoS header + padding */
+#define XONE_DONGLE_LEN_PKT_HDR (MT_CMD_HDR_LEN + 8 + \
+				 sizeof(struct mt76_txwi) + \
+				 sizeof(struct ieee80211_qos_hdr) + 2)
+
+/* multiple messages + trailer */
+#define XONE_DONGLE_NUM_AGG_URBS 2
+#define XONE_DONGLE_LEN_AGG_BUF 0x1000
+
+/* maximum number of messages per aggregated transfer */
+#define XONE_DONGLE_MAX_AGG_FRAMES 8
+
+/* time for pending transfers to complete before stopping (in ms) */
+#define XONE_DONGLE_TX_TIMEOUT 100
+
+/* up to 4 bytes of padding + trailer */
+#define XONE_DONGLE_LEN_OUT_BUF (XONE_DONGLE_LEN_CMD_PKT + sizeof(u32) + \
+				 MT_CMD_HDR_LEN)
+
+/* RX aggregation limit in KiB, leaves room for a maximum size message */
+#define XONE_DONGLE_RX_AGG_LIMIT 30
+
 #define XONE_DONGLE_MAX_CLIENTS 16
 
+/* OUT buffers guaranteed to each client */
+#define XONE_DONGLE_TX_RESERVED 1
+#define XONE_DONGLE_TX_SHARED \
+	(XONE_DONGLE_NUM_OUT_URBS - \
+	 XONE_DONGLE_MAX_CLIENTS * XONE_DONGLE_TX_RESERVED)
+
+/* maximum number of queued messages per client */
+#define XONE_DONGLE_MAX_TX_QUEUE 8
+
+/* dedicated buffers for audio playback */
+#define XONE_DONGLE_NUM_AUDIO_URBS 4
+#define XONE_DONGLE_AUDIO_DEPTH 1
+
+/* jitter buffer for audio capture */
+#define XONE_DONGLE_AUDIO_SLOTS 8
+#define XONE_DONGLE_AUDIO_PREFILL 2
+#define XONE_DONGLE_LEN_AUDIO_SLOT XONE_DONGLE_LEN_CMD_PKT
+
+/* pending management events, duplicates are merged */
+#define XONE_DONGLE_NUM_EVENTS 64
+
+/* maximum number of URBs processed per RX work run */
+#define XONE_DONGLE_MAX_RX_BUDGET 64
+
 /* autosuspend delay in ms */
 #define XONE_DONGLE_SUSPEND_DELAY 60000
 
 #define XONE_DONGLE_PAIRING_TIMEOUT msecs_to_jiffies(30000)
 #define XONE_DONGLE_PWR_OFF_TIMEOUT msecs_to_jiffies(5000)
 
+/* channel monitoring while clients are connected */
+#define XONE_DONGLE_CH_MONITOR_INTERVAL msecs_to_jiffies(5000)
+#define XONE_DONGLE_CH_DEGRADED_PERIODS 3
+
+/* channel load and TX failures or RX gaps (in per mille) considered degraded */
+#define XONE_DONGLE_CH_LOAD_LIMIT 500
+#define XONE_DONGLE_CH_LOAD_MARGIN 200
+#define XONE_DONGLE_CH_FAILURE_LIMIT 100
+
+/* maximum age of a candidate's measurement in ms */
+#define XONE_DONGLE_CH_SURVEY_AGE 5000
+
+/* a client outweighs any channel load when steering pairing */
+#define XONE_DONGLE_CLIENT_LOAD 2000
+
+/* averaged signal attenuation (in dB) */
+DECLARE_EWMA(xone_signal, 4, 8)
+
 enum xone_dongle_queue {
 	XONE_DONGLE_QUEUE_DATA = 0x00,
 	XONE_DONGLE_QUEUE_AUDIO = 0x02,
 };
 
-struct xone_dongle_skb_cb {
+/* context of an OUT URB, bound to it at init */
+struct xone_dongle_tx_context {
 	struct xone_dongle *dongle;
-	struct urb *urb;
+
+	/* owner of a dedicated audio URB */
+	struct xone_dongle_client *client;
+
+	/* client charged for the buffer, protected by the TX lock */
+	int owner;
 };
 
 struct xone_dongle_client {
@@ -43,6 +125,46 @@ struct xone_dongle_client {
 	u8 address[ETH_ALEN];
 
 	struct gip_adapter *adapter;
+
+	/* held by the clients array and RX processing */
+	struct kref ref;
+	struct completion released;
+
+	/* transmit queue, protected by the dongle's TX lock */
+	struct urb *tx_queue[XONE_DONGLE_MAX_TX_QUEUE];
+	struct list_head tx_node;
+	int tx_head;
+	int tx_queued;
+	int tx_claimed;
+	int tx_deficit;
+	u32 tx_drops;
+
+	/* audio playback, buffers exist while audio is enabled */
+	struct xone_dongle_tx_context audio_ctx[XONE_DONGLE_NUM_AUDIO_URBS];
+	struct usb_anchor urbs_audio_idle;
+	struct usb_anchor urbs_audio_busy;
+
+	/* serializes audio submission and access to received audio */
+	spinlock_t audio_lock;
+	struct hrtimer audio_timer;
+	u8 *audio_slots;
+	int audio_len[XONE_DONGLE_AUDIO_SLOTS];
+	int audio_head;
+	int audio_count;
+	bool audio_in;
+	bool audio_playing;
+	bool audio_stopped;
+	u32 audio_underruns;
+	u32 audio_overruns;
+
+	/* link quality, updated from RX processing */
+	struct ewma_xone_signal link_rssi;
+	u16 link_rate;
+	u16 link_sn[IEEE80211_NUM_TIDS];
+	u16 link_sn_valid;
+	u32 link_frames;
+	u32 link_retries;
+	u32 link_lost;
 };
 
 struct xone_dongle_event {
@@ -51,46 +173,129 @@ struct xone_dongle_event {
 		XONE_DONGLE_EVT_REMOVE_CLIENT,
 		XONE_DONGLE_EVT_PAIR_CLIENT,
 		XONE_DONGLE_EVT_ENABLE_PAIRING,
+		XONE_DONGLE_EVT_MONITOR_CHANNEL,
 	} type;
 
-	struct xone_dongle *dongle;
 	u8 address[ETH_ALEN];
 	u8 wcid;
-
-	struct work_struct work;
 };
 
 struct xone_dongle {
 	struct xone_mt76 mt;
 
-	struct usb_anchor urbs_in_idle;
-	struct usb_anchor urbs_in_busy;
-	struct usb_anchor urbs_out_idle;
-	struct usb_anchor urbs_out_busy;
+	/* entry in the list of dongles with a channel */
+	struct list_head node;
+
+	/* firmware and radio initialization after probe */
+	struct work_struct init_work;
+	bool ready;
 
 	/* serializes pairing changes */
 	struct mutex pairing_lock;
 	struct delayed_work pairing_work;
 	bool pairing;
 
-	/* serializes access to clients array */
-	spinlock_t clients_lock;
-	struct xone_dongle_client *clients[XONE_DONGLE_MAX_CLIENTS];
+	/* pairing requested by another dongle */
+	struct work_struct steer_work;
+
+	/* runtime channel monitoring */
+	struct delayed_work channel_work;
+	atomic_t channel_losses;
+	atomic_t channel_frames;
+	atomic_t channel_gaps;
+	int channel_degraded;
+	u32 channel_switches;
+
 	atomic_t client_count;
 	wait_queue_head_t disconnect_wait;
 
-	struct workqueue_struct *event_wq;
+	/* serializes access to event ring */
+	spinlock_t events_lock;
+	struct xone_dongle_event events[XONE_DONGLE_NUM_EVENTS];
+	int events_head;
+	int events_count;
+	u32 events_dropped;
+	struct work_struct event_work;
+
+	/* receive path */
+	struct usb_anchor urbs_in_idle ____cacheline_aligned_in_smp;
+	struct usb_anchor urbs_in_busy;
+	struct usb_anchor urbs_in_done;
+	struct work_struct rx_work;
+	int rx_budget;
+	int rx_cpu;
+
+	/* serializes changes to clients array, readers use RCU */
+	spinlock_t clients_lock;
+	struct xone_dongle_client __rcu *clients[XONE_DONGLE_MAX_CLIENTS];
+
+	/* transmit path */
+	struct usb_anchor urbs_out_idle ____cacheline_aligned_in_smp;
+	struct usb_anchor urbs_out_busy;
+
+	/* serializes submission, TX queues and pending messages */
+	spinlock_t tx_lock;
+	struct xone_dongle_tx_context tx_contexts[XONE_DONGLE_NUM_OUT_URBS +
+						  XONE_DONGLE_NUM_AGG_URBS];
+	struct list_head tx_active;
+	int tx_held[XONE_DONGLE_MAX_CLIENTS];
+	int tx_shared;
+	int tx_inflight;
+	bool tx_stopped;
+
+	struct usb_anchor urbs_out_pending;
+	struct usb_anchor urbs_agg_idle;
+	struct hrtimer tx_timer;
+	ktime_t tx_delay;
+	int tx_pending_len;
+	int tx_pending_count;
+
+	u32 tx_frames;
+	u32 tx_transfers;
 };
 
-static void xone_dongle_prep_packet(struct xone_dongle_client *client,
-				    struct sk_buff *skb,
-				    enum xone_dongle_queue queue)
+static bool xone_dongle_rx_aggregation = true;
+module_param_named(rx_aggregation, xone_dongle_rx_aggregation, bool, 0444);
+MODULE_PARM_DESC(rx_aggregation, "Receive multiple messages per URB");
+
+static uint xone_dongle_rx_budget;
+module_param_named(rx_budget, xone_dongle_rx_budget, uint, 0644);
+MODULE_PARM_DESC(rx_budget,
+		 "URBs processed per RX work run (0 = process in completion)");
+
+static int xone_dongle_rx_cpu = -1;
+module_param_named(rx_cpu, xone_dongle_rx_cpu, int, 0644);
+MODULE_PARM_DESC(rx_cpu, "CPU used for RX processing (-1 = any)");
+
+static uint xone_dongle_tx_aggregation;
+module_param_named(tx_aggregation, xone_dongle_tx_aggregation, uint, 0444);
+MODULE_PARM_DESC(tx_aggregation,
+		 "Maximum TX aggregation delay in μs (0 = disabled)");
+
+static bool xone_dongle_channel_switch;
+module_param_named(channel_switch, xone_dongle_channel_switch, bool, 0644);
+MODULE_PARM_DESC(channel_switch, "Move clients away from degraded channels");
+
+static bool xone_dongle_pairing_steering;
+module_param_named(pairing_steering, xone_dongle_pairing_steering, bool, 0644);
+MODULE_PARM_DESC(pairing_steering,
+		 "Pair new clients with the least busy dongle");
+
+/* serializes access to the dongle list and channel selection */
+static DEFINE_MUTEX(xone_dongle_list_lock);
+static LIST_HEAD(xone_dongle_list);
+static struct dentry *xone_dongle_debugfs;
+
+static int xone_dongle_prep_packet(struct xone_dongle_client *client,
+				   u8 *buf, int len,
+				   enum xone_dongle_queue queue)
 {
 	struct ieee80211_qos_hdr hdr = {};
 	struct mt76_txwi txwi = {};
 	u8 data[] = {
 		0x00, 0x00, queue, client->wcid - 1, 0x00, 0x00, 0x00, 0x00,
 	};
+	u8 *pos = buf + MT_CMD_HDR_LEN;
 
 	/* frame is sent from AP (DS) */
 	/* duration is the time required to transmit (in μs) */
@@ -107,86 +312,651 @@ static void xone_dongle_prep_packet(struct xone_dongle_client *client,
 					    IEEE80211_HT_MPDU_DENSITY_4));
 	txwi.rate = cpu_to_le16(FIELD_PREP(MT_RXWI_RATE_PHY, MT_PHY_TYPE_OFDM));
 	txwi.ack_ctl = MT_TXWI_ACK_CTL_REQ;
-	txwi.len_ctl = cpu_to_le16(sizeof(hdr) + skb->len);
+	txwi.len_ctl = cpu_to_le16(sizeof(hdr) + len);
+
+	/* headers are written in front of the payload */
+	memcpy(pos, data, sizeof(data));
+	pos += sizeof(data);
+	memcpy(pos, &txwi, sizeof(txwi));
+	pos += sizeof(txwi);
+	memcpy(pos, &hdr, sizeof(hdr));
+	pos += sizeof(hdr);
+	memset(pos, 0, 2);
+
+	return xone_mt76_prep_command_buffer(buf, XONE_DONGLE_LEN_PKT_HDR -
+					     MT_CMD_HDR_LEN + len, 0);
+}
+
+static int xone_dongle_init_urbs_out(struct xone_dongle *dongle,
+				     struct xone_dongle_tx_context *ctx,
+				     struct usb_anchor *anchor, int count,
+				     int buf_len, usb_complete_t complete)
+{
+	struct xone_mt76 *mt = &dongle->mt;
+	struct urb *urb;
+	void *buf;
+	int i;
 
-	memset(skb_push(skb, 2), 0, 2);
-	memcpy(skb_push(skb, sizeof(hdr)), &hdr, sizeof(hdr));
-	memcpy(skb_push(skb, sizeof(txwi)), &txwi, sizeof(txwi));
-	memcpy(skb_push(skb, sizeof(data)), data, sizeof(data));
+	for (i = 0; i < count; i++) {
+		urb = usb_alloc_urb(0, GFP_KERNEL);
+		if (!urb)
+			return -ENOMEM;
 
-	xone_mt76_prep_command(skb, 0);
+		usb_anchor_urb(urb, anchor);
+		usb_free_urb(urb);
+
+		/* buffer stays bound to the URB */
+		buf = usb_alloc_coherent(mt->udev, buf_len,
+					 GFP_KERNEL, &urb->transfer_dma);
+		if (!buf)
+			return -ENOMEM;
+
+		ctx[i].dongle = dongle;
+		usb_fill_bulk_urb(urb, mt->udev,
+				  usb_sndbulkpipe(mt->udev, XONE_MT_EP_OUT),
+				  buf, buf_len, complete, &ctx[i]);
+		urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
+	}
+
+	return 0;
+}
+
+static void xone_dongle_free_urbs(struct usb_anchor *anchor, int buf_len)
+{
+	struct urb *urb;
+
+	while ((urb = usb_get_from_anchor(anchor))) {
+		usb_free_coherent(urb->dev, buf_len,
+				  urb->transfer_buffer, urb->transfer_dma);
+		usb_free_urb(urb);
+	}
 }
 
 static int xone_dongle_get_buffer(struct gip_adapter *adap,
 				  struct gip_adapter_buffer *buf)
 {
 	struct xone_dongle_client *client = dev_get_drvdata(&adap->dev);
-	struct xone_dongle_skb_cb *cb;
-	struct urb *urb;
-	struct sk_buff *skb;
+	struct xone_dongle *dongle = client->dongle;
+	int *held = &dongle->tx_held[client->wcid - 1];
+	struct xone_dongle_tx_context *ctx;
+	struct urb *urb = NULL;
+	unsigned long flags;
+
+	/* audio has dedicated buffers */
+	if (buf->type == GIP_BUF_AUDIO) {
+		urb = usb_get_from_anchor(&client->urbs_audio_idle);
+		if (!urb)
+			return -ENOSPC;
+
+		goto fill_buffer;
+	}
 
-	urb = usb_get_from_anchor(&client->dongle->urbs_out_idle);
-	if (!urb)
+	spin_lock_irqsave(&dongle->tx_lock, flags);
+
+	/* buffers beyond the reserved minimum are shared by all clients */
+	if (client->tx_queued + client->tx_claimed < XONE_DONGLE_MAX_TX_QUEUE &&
+	    (*held < XONE_DONGLE_TX_RESERVED ||
+	     dongle->tx_shared < XONE_DONGLE_TX_SHARED))
+		urb = usb_get_from_anchor(&dongle->urbs_out_idle);
+
+	if (!urb) {
+		client->tx_drops++;
+		spin_unlock_irqrestore(&dongle->tx_lock, flags);
 		return -ENOSPC;
+	}
 
-	skb = xone_mt76_alloc_message(XONE_DONGLE_LEN_CMD_PKT, GFP_ATOMIC);
-	if (!skb)
-		return -ENOMEM;
+	if ((*held)++ >= XONE_DONGLE_TX_RESERVED)
+		dongle->tx_shared++;
+
+	/* charged to the client until the transfer completes */
+	ctx = urb->context;
+	ctx->owner = client->wcid - 1;
+
+	/* queue slot is taken on submission */
+	client->tx_claimed++;
+	spin_unlock_irqrestore(&dongle->tx_lock, flags);
+
+fill_buffer:
+	/* headroom for xone_dongle_prep_packet */
+	buf->context = urb;
+	buf->data = urb->transfer_buffer + XONE_DONGLE_LEN_PKT_HDR;
+	buf->length = XONE_DONGLE_LEN_CMD_PKT - XONE_DONGLE_LEN_PKT_HDR;
+
+	return 0;
+}
+
+static void xone_dongle_release_urb(struct xone_dongle *dongle,
+				    struct urb *urb)
+{
+	struct xone_dongle_tx_context *ctx = urb->context;
+	int *held = &dongle->tx_held[ctx->owner];
+
+	lockdep_assert_held(&dongle->tx_lock);
+
+	if (--(*held) >= XONE_DONGLE_TX_RESERVED)
+		dongle->tx_shared--;
+
+	usb_anchor_urb(urb, &dongle->urbs_out_idle);
+}
+
+static int xone_dongle_submit_urb(struct xone_dongle *dongle, struct urb *urb,
+				  int frames)
+{
+	int err;
 
-	/* command header + WCID data + TXWI + QoS header + padding */
-	/* see xone_dongle_prep_packet and xone_mt76_prep_message */
-	skb_reserve(skb, MT_CMD_HDR_LEN + 8 + sizeof(struct mt76_txwi) +
-		    sizeof(struct ieee80211_qos_hdr) + 2 + MT_CMD_HDR_LEN);
+	lockdep_assert_held(&dongle->tx_lock);
 
-	cb = (struct xone_dongle_skb_cb *)skb->cb;
-	cb->dongle = client->dongle;
-	cb->urb = urb;
+	usb_anchor_urb(urb, &dongle->urbs_out_busy);
 
-	buf->context = skb;
-	buf->data = skb->data;
-	buf->length = skb_tailroom(skb);
+	/* can fail during USB device removal */
+	err = usb_submit_urb(urb, GFP_ATOMIC);
+	if (err) {
+		dev_dbg(dongle->mt.dev, "%s: submit failed: %d\n",
+			__func__, err);
+		usb_unanchor_urb(urb);
+		return err;
+	}
+
+	dongle->tx_inflight++;
+	dongle->tx_frames += frames;
+	dongle->tx_transfers++;
 
 	return 0;
 }
 
+static void xone_dongle_submit_each(struct xone_dongle *dongle,
+				    struct usb_anchor *anchor)
+{
+	struct urb *urb;
+
+	while ((urb = usb_get_from_anchor(anchor))) {
+		if (xone_dongle_submit_urb(dongle, urb, 1))
+			xone_dongle_release_urb(dongle, urb);
+
+		usb_free_urb(urb);
+	}
+}
+
+static void xone_dongle_flush_tx(struct xone_dongle *dongle)
+{
+	struct usb_anchor copied;
+	struct urb *agg, *urb;
+	int len = 0;
+	int frames = dongle->tx_pending_count;
+
+	lockdep_assert_held(&dongle->tx_lock);
+
+	dongle->tx_pending_len = 0;
+	dongle->tx_pending_count = 0;
+
+	/* send single messages without copying */
+	agg = frames > 1 ? usb_get_from_anchor(&dongle->urbs_agg_idle) : NULL;
+	if (!agg) {
+		xone_dongle_submit_each(dongle, &dongle->urbs_out_pending);
+		return;
+	}
+
+	init_usb_anchor(&copied);
+
+	/* trailer is only required at the end of the transfer */
+	while ((urb = usb_get_from_anchor(&dongle->urbs_out_pending))) {
+		memcpy(agg->transfer_buffer + len, urb->transfer_buffer,
+		       urb->transfer_buffer_length - MT_CMD_HDR_LEN);
+		len += urb->transfer_buffer_length - MT_CMD_HDR_LEN;
+		usb_anchor_urb(urb, &copied);
+		usb_free_urb(urb);
+	}
+
+	memset(agg->transfer_buffer + len, 0, MT_CMD_HDR_LEN);
+	agg->transfer_buffer_length = len + MT_CMD_HDR_LEN;
+
+	/* messages are still intact, fall back to separate transfers */
+	if (xone_dongle_submit_urb(dongle, agg, frames)) {
+		usb_anchor_urb(agg, &dongle->urbs_agg_idle);
+		xone_dongle_submit_each(dongle, &copied);
+	}
+
+	while ((urb = usb_get_from_anchor(&copied))) {
+		xone_dongle_release_urb(dongle, urb);
+		usb_free_urb(urb);
+	}
+
+	usb_free_urb(agg);
+}
+
+static enum hrtimer_restart xone_dongle_tx_timeout(struct hrtimer *timer)
+{
+	struct xone_dongle *dongle = container_of(timer, typeof(*dongle),
+						  tx_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&dongle->tx_lock, flags);
+	xone_dongle_flush_tx(dongle);
+	spin_unlock_irqrestore(&dongle->tx_lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+static void xone_dongle_aggregate_tx(struct xone_dongle *dongle,
+				     struct urb *urb)
+{
+	int len = urb->transfer_buffer_length - MT_CMD_HDR_LEN;
+
+	lockdep_assert_held(&dongle->tx_lock);
+
+	/* message does not fit into the pending transfer */
+	if (dongle->tx_pending_len + len + MT_CMD_HDR_LEN >
+	    XONE_DONGLE_LEN_AGG_BUF) {
+		hrtimer_try_to_cancel(&dongle->tx_timer);
+		xone_dongle_flush_tx(dongle);
+	}
+
+	usb_anchor_urb(urb, &dongle->urbs_out_pending);
+	dongle->tx_pending_len += len;
+
+	/* deadline starts with the first pending message */
+	if (!dongle->tx_pending_count++)
+		hrtimer_start(&dongle->tx_timer, dongle->tx_delay,
+			      HRTIMER_MODE_REL);
+
+	if (dongle->tx_pending_count >= XONE_DONGLE_MAX_AGG_FRAMES) {
+		hrtimer_try_to_cancel(&dongle->tx_timer);
+		xone_dongle_flush_tx(dongle);
+	}
+}
+
+static void xone_dongle_dispatch_tx(struct xone_dongle *dongle,
+				    struct urb *urb)
+{
+	u8 *data = urb->transfer_buffer + MT_CMD_HDR_LEN;
+
+	/* audio is paced by the driver, aggregation only delays it */
+	if (dongle->tx_delay && data[2] == XONE_DONGLE_QUEUE_DATA) {
+		xone_dongle_aggregate_tx(dongle, urb);
+		return;
+	}
+
+	if (xone_dongle_submit_urb(dongle, urb, 1))
+		xone_dongle_release_urb(dongle, urb);
+}
+
+static void xone_dongle_schedule_tx(struct xone_dongle *dongle)
+{
+	struct xone_dongle_client *client;
+	struct urb *urb;
+
+	lockdep_assert_held(&dongle->tx_lock);
+
+	/* deficit round robin, weighted by transfer length */
+	while (!dongle->tx_stopped && !list_empty(&dongle->tx_active) &&
+	       dongle->tx_inflight < XONE_DONGLE_MAX_TX_INFLIGHT) {
+		client = list_first_entry(&dongle->tx_active,
+					  typeof(*client), tx_node);
+		urb = client->tx_queue[client->tx_head];
+
+		/* quantum always covers a message of maximum length */
+		if (urb->transfer_buffer_length > client->tx_deficit) {
+			client->tx_deficit += XONE_DONGLE_LEN_OUT_BUF;
+			list_move_tail(&client->tx_node, &dongle->tx_active);
+			continue;
+		}
+
+		client->tx_deficit -= urb->transfer_buffer_length;
+		client->tx_head = (client->tx_head + 1) %
+				  XONE_DONGLE_MAX_TX_QUEUE;
+
+		if (!--client->tx_queued) {
+			client->tx_deficit = 0;
+			list_del_init(&client->tx_node);
+		}
+
+		xone_dongle_dispatch_tx(dongle, urb);
+		usb_free_urb(urb);
+	}
+}
+
+static void xone_dongle_purge_tx(struct xone_dongle_client *client)
+{
+	struct xone_dongle *dongle = client->dongle;
+	struct urb *urb;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dongle->tx_lock, flags);
+
+	while (client->tx_queued) {
+		urb = client->tx_queue[client->tx_head];
+		client->tx_head = (client->tx_head + 1) %
+				  XONE_DONGLE_MAX_TX_QUEUE;
+		client->tx_queued--;
+
+		xone_dongle_release_urb(dongle, urb);
+		usb_free_urb(urb);
+	}
+
+	list_del_init(&client->tx_node);
+	spin_unlock_irqrestore(&dongle->tx_lock, flags);
+}
+
+static void xone_dongle_start_tx(struct xone_dongle *dongle)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dongle->tx_lock, flags);
+	dongle->tx_stopped = false;
+	xone_dongle_schedule_tx(dongle);
+	spin_unlock_irqrestore(&dongle->tx_lock, flags);
+}
+
+static void xone_dongle_stop_tx(struct xone_dongle *dongle)
+{
+	/* send pending messages before killing the URBs */
+	hrtimer_cancel(&dongle->tx_timer);
+
+	spin_lock_irq(&dongle->tx_lock);
+	dongle->tx_stopped = true;
+	xone_dongle_flush_tx(dongle);
+	spin_unlock_irq(&dongle->tx_lock);
+
+	if (!usb_wait_anchor_empty_timeout(&dongle->urbs_out_busy,
+					   XONE_DONGLE_TX_TIMEOUT))
+		dev_dbg(dongle->mt.dev, "%s: transfers pending\n", __func__);
+}
+
+static int xone_dongle_submit_audio(struct xone_dongle_client *client,
+				    struct urb *urb)
+{
+	struct gip_adapter *adap = client->adapter;
+	unsigned long flags;
+	int err;
+
+	/* bypasses the scheduler to keep the pacing of the driver */
+	spin_lock_irqsave(&client->audio_lock, flags);
+
+	if (client->audio_stopped) {
+		usb_anchor_urb(urb, &client->urbs_audio_idle);
+		spin_unlock_irqrestore(&client->audio_lock, flags);
+		usb_free_urb(urb);
+		return -ESHUTDOWN;
+	}
+
+	usb_anchor_urb(urb, &client->urbs_audio_busy);
+	atomic_inc(&adap->audio_pending);
+
+	err = usb_submit_urb(urb, GFP_ATOMIC);
+	if (err) {
+		atomic_dec(&adap->audio_pending);
+		usb_unanchor_urb(urb);
+		usb_anchor_urb(urb, &client->urbs_audio_idle);
+	}
+
+	spin_unlock_irqrestore(&client->audio_lock, flags);
+	usb_free_urb(urb);
+
+	return err;
+}
+
 static int xone_dongle_submit_buffer(struct gip_adapter *adap,
 				     struct gip_adapter_buffer *buf)
 {
 	struct xone_dongle_client *client = dev_get_drvdata(&adap->dev);
-	struct xone_dongle_skb_cb *cb;
-	struct sk_buff *skb = buf->context;
-	int err;
-
-	skb_put(skb, buf->length);
+	struct xone_dongle *dongle = client->dongle;
+	struct urb *urb = buf->context;
+	enum xone_dongle_queue queue;
+	unsigned long flags;
+	int tail;
 
 	if (buf->type == GIP_BUF_DATA)
-		xone_dongle_prep_packet(client, skb, XONE_DONGLE_QUEUE_DATA);
+		queue = XONE_DONGLE_QUEUE_DATA;
 	else if (buf->type == GIP_BUF_AUDIO)
-		xone_dongle_prep_packet(client, skb, XONE_DONGLE_QUEUE_AUDIO);
+		queue = XONE_DONGLE_QUEUE_AUDIO;
 	else
 		return -EINVAL;
 
-	cb = (struct xone_dongle_skb_cb *)skb->cb;
-	cb->urb->context = skb;
-	cb->urb->transfer_buffer = skb->data;
-	cb->urb->transfer_buffer_length = skb->len;
-	usb_anchor_urb(cb->urb, &client->dongle->urbs_out_busy);
+	urb->transfer_buffer_length =
+		xone_dongle_prep_packet(client, urb->transfer_buffer,
+					buf->length, queue);
 
-	err = usb_submit_urb(cb->urb, GFP_ATOMIC);
+	if (buf->type == GIP_BUF_AUDIO)
+		return xone_dongle_submit_audio(client, urb);
+
+	spin_lock_irqsave(&dongle->tx_lock, flags);
+	client->tx_claimed--;
+
+	/* refused while suspended or removed */
+	if (dongle->tx_stopped) {
+		xone_dongle_release_urb(dongle, urb);
+		spin_unlock_irqrestore(&dongle->tx_lock, flags);
+		usb_free_urb(urb);
+		return -ESHUTDOWN;
+	}
+
+	/* queue keeps the reference from xone_dongle_get_buffer */
+	tail = (client->tx_head + client->tx_queued++) %
+	       XONE_DONGLE_MAX_TX_QUEUE;
+	client->tx_queue[tail] = urb;
+
+	if (list_empty(&client->tx_node))
+		list_add_tail(&client->tx_node, &dongle->tx_active);
+
+	xone_dongle_schedule_tx(dongle);
+	spin_unlock_irqrestore(&dongle->tx_lock, flags);
+
+	return 0;
+}
+
+static void xone_dongle_release_buffer(struct gip_adapter *adap,
+				       struct gip_adapter_buffer *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(&adap->dev);
+	struct xone_dongle *dongle = client->dongle;
+	struct urb *urb = buf->context;
+	unsigned long flags;
+
+	if (buf->type == GIP_BUF_AUDIO) {
+		usb_anchor_urb(urb, &client->urbs_audio_idle);
+		usb_free_urb(urb);
+		return;
+	}
+
+	/* undo the claim of xone_dongle_get_buffer */
+	spin_lock_irqsave(&dongle->tx_lock, flags);
+	client->tx_claimed--;
+	xone_dongle_release_urb(dongle, urb);
+	spin_unlock_irqrestore(&dongle->tx_lock, flags);
+
+	usb_free_urb(urb);
+}
+
+static void xone_dongle_complete_audio(struct urb *urb)
+{
+	struct xone_dongle_tx_context *ctx = urb->context;
+	struct xone_dongle_client *client = ctx->client;
+
+	usb_anchor_urb(urb, &client->urbs_audio_idle);
+	atomic_dec(&client->adapter->audio_pending);
+}
+
+static bool xone_dongle_queue_audio(struct xone_dongle_client *client,
+				    u8 *data, int len)
+{
+	unsigned long flags;
+	int tail;
+
+	spin_lock_irqsave(&client->audio_lock, flags);
+
+	if (!client->audio_in || len > XONE_DONGLE_LEN_AUDIO_SLOT) {
+		spin_unlock_irqrestore(&client->audio_lock, flags);
+		return false;
+	}
+
+	/* drop the oldest samples on overflow */
+	if (client->audio_count == XONE_DONGLE_AUDIO_SLOTS) {
+		client->audio_head = (client->audio_head + 1) %
+				     XONE_DONGLE_AUDIO_SLOTS;
+		client->audio_count--;
+		client->audio_overruns++;
+	}
+
+	tail = (client->audio_head + client->audio_count++) %
+	       XONE_DONGLE_AUDIO_SLOTS;
+	memcpy(client->audio_slots + tail * XONE_DONGLE_LEN_AUDIO_SLOT,
+	       data, len);
+	client->audio_len[tail] = len;
+
+	spin_unlock_irqrestore(&client->audio_lock, flags);
+
+	return true;
+}
+
+static enum hrtimer_restart xone_dongle_release_audio(struct hrtimer *timer)
+{
+	struct xone_dongle_client *client = container_of(timer, typeof(*client),
+							 audio_timer);
+	u8 *data = client->audio_slots +
+		   XONE_DONGLE_AUDIO_SLOTS * XONE_DONGLE_LEN_AUDIO_SLOT;
+	unsigned long flags;
+	int head, len = 0;
+	int err;
+
+	spin_lock_irqsave(&client->audio_lock, flags);
+
+	/* refill the buffer after an underrun */
+	if (!client->audio_playing &&
+	    client->audio_count >= XONE_DONGLE_AUDIO_PREFILL)
+		client->audio_playing = true;
+
+	if (client->audio_playing && !client->audio_count) {
+		client->audio_playing = false;
+		client->audio_underruns++;
+	}
+
+	/* release one buffer per interval */
+	if (client->audio_playing) {
+		head = client->audio_head;
+		len = client->audio_len[head];
+		memcpy(data, client->audio_slots +
+		       head * XONE_DONGLE_LEN_AUDIO_SLOT, len);
+		client->audio_head = (head + 1) % XONE_DONGLE_AUDIO_SLOTS;
+		client->audio_count--;
+	}
+
+	spin_unlock_irqrestore(&client->audio_lock, flags);
+
+	/* slot can be reused as soon as the lock is dropped */
+	if (len) {
+		err = gip_process_buffer(client->adapter, data, len);
+		if (err)
+			dev_err(client->dongle->mt.dev,
+				"%s: process failed: %d\n", __func__, err);
+	}
+
+	hrtimer_forward_now(timer, ms_to_ktime(GIP_AUDIO_INTERVAL));
+
+	return HRTIMER_RESTART;
+}
+
+static int xone_dongle_enable_audio(struct gip_adapter *adap)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(&adap->dev);
+	int i, err;
+
+	if (client->audio_slots)
+		return -EALREADY;
+
+	/* last slot holds the buffer being processed */
+	client->audio_slots = kcalloc(XONE_DONGLE_AUDIO_SLOTS + 1,
+				      XONE_DONGLE_LEN_AUDIO_SLOT, GFP_KERNEL);
+	if (!client->audio_slots)
+		return -ENOMEM;
+
+	for (i = 0; i < XONE_DONGLE_NUM_AUDIO_URBS; i++)
+		client->audio_ctx[i].client = client;
+
+	err = xone_dongle_init_urbs_out(client->dongle,
+					client->audio_ctx,
+					&client->urbs_audio_idle,
+					XONE_DONGLE_NUM_AUDIO_URBS,
+					XONE_DONGLE_LEN_OUT_BUF,
+					xone_dongle_complete_audio);
 	if (err) {
-		usb_unanchor_urb(cb->urb);
-		usb_anchor_urb(cb->urb, &client->dongle->urbs_out_idle);
-		dev_kfree_skb_any(skb);
+		xone_dongle_free_urbs(&client->urbs_audio_idle,
+				      XONE_DONGLE_LEN_OUT_BUF);
+		kfree(client->audio_slots);
+		client->audio_slots = NULL;
 	}
 
-	usb_free_urb(cb->urb);
+	return err;
+}
+
+static int xone_dongle_init_audio_in(struct gip_adapter *adap)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(&adap->dev);
+
+	if (!client->audio_slots)
+		return -ENOTSUPP;
+
+	spin_lock_irq(&client->audio_lock);
+	client->audio_head = 0;
+	client->audio_count = 0;
+	client->audio_playing = false;
+	client->audio_in = true;
+	spin_unlock_irq(&client->audio_lock);
+
+	hrtimer_start(&client->audio_timer, ms_to_ktime(GIP_AUDIO_INTERVAL),
+		      HRTIMER_MODE_REL);
+
+	return 0;
+}
+
+static int xone_dongle_init_audio_out(struct gip_adapter *adap, int pkt_len)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(&adap->dev);
+
+	if (!client->audio_slots)
+		return -ENOTSUPP;
+
+	if (pkt_len > XONE_DONGLE_LEN_CMD_PKT - XONE_DONGLE_LEN_PKT_HDR)
+		return -EINVAL;
+
+	/* completions do not reflect the consumption by the device */
+	adap->audio_depth = XONE_DONGLE_AUDIO_DEPTH;
+	adap->audio_interval = 0;
+	atomic_set(&adap->audio_pending, 0);
+
+	return 0;
+}
+
+static int xone_dongle_disable_audio(struct gip_adapter *adap)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(&adap->dev);
+
+	if (!client->audio_slots)
+		return -EALREADY;
+
+	hrtimer_cancel(&client->audio_timer);
+
+	spin_lock_irq(&client->audio_lock);
+	client->audio_in = false;
+	spin_unlock_irq(&client->audio_lock);
+
+	usb_kill_anchored_urbs(&client->urbs_audio_busy);
+	xone_dongle_free_urbs(&client->urbs_audio_idle,
+			      XONE_DONGLE_LEN_OUT_BUF);
+
+	kfree(client->audio_slots);
+	client->audio_slots = NULL;
 
-	return err;
+	return 0;
 }
 
 static struct gip_adapter_ops xone_dongle_adapter_ops = {
 	.get_buffer = xone_dongle_get_buffer,
 	.submit_buffer = xone_dongle_submit_buffer,
+	.release_buffer = xone_dongle_release_buffer,
+	.enable_audio = xone_dongle_enable_audio,
+	.init_audio_in = xone_dongle_init_audio_in,
+	.init_audio_out = xone_dongle_init_audio_out,
+	.disable_audio = xone_dongle_disable_audio,
 };
 
 static int xone_dongle_toggle_pairing(struct xone_dongle *dongle, bool enable)
@@ -243,6 +1013,293 @@ static void xone_dongle_pairing_timeout(struct work_struct *work)
 			__func__, err);
 }
 
+/* avoid channels of other dongles, called with the list lock held */
+static void xone_dongle_avoid_channels(struct xone_dongle *dongle)
+{
+	struct xone_dongle *other;
+
+	dongle->mt.channels_used = 0;
+
+	list_for_each_entry(other, &xone_dongle_list, node)
+		if (other != dongle)
+			xone_mt76_avoid_channel(&dongle->mt,
+						other->mt.channel);
+}
+
+static int xone_dongle_monitor_channel(struct xone_dongle *dongle)
+{
+	struct xone_mt76 *mt = &dongle->mt;
+	struct xone_mt76_channel *chan;
+	int losses = atomic_xchg(&dongle->channel_losses, 0);
+	int frames = atomic_xchg(&dongle->channel_frames, 0);
+	int gaps = atomic_xchg(&dongle->channel_gaps, 0);
+	int load, failures, limit, err;
+
+	xone_mt76_survey_channel(mt, mt->channel);
+	load = xone_mt76_get_channel_load(mt->channel);
+	failures = mt->channel->tx_failures;
+
+	/* frames missing from the clients count like TX failures */
+	if (frames + gaps)
+		failures = max(failures, gaps * 1000 / (frames + gaps));
+
+	/* busy channels delay packets, failures and losses drop them */
+	if (load < XONE_DONGLE_CH_LOAD_LIMIT &&
+	    failures < XONE_DONGLE_CH_FAILURE_LIMIT && !losses) {
+		dongle->channel_degraded = 0;
+		return 0;
+	}
+
+	dev_dbg(mt->dev, "%s: channel=%u, load=%d, failures=%d, losses=%d\n",
+		__func__, mt->channel->index, load, failures, losses);
+
+	if (++dongle->channel_degraded < XONE_DONGLE_CH_DEGRADED_PERIODS ||
+	    !READ_ONCE(xone_dongle_channel_switch))
+		return 0;
+
+	mutex_lock(&xone_dongle_list_lock);
+	xone_dongle_avoid_channels(dongle);
+	chan = xone_mt76_find_channel(mt);
+	mutex_unlock(&xone_dongle_list_lock);
+
+	if (!chan)
+		return 0;
+
+	/* only switch if the other channel is less busy */
+	limit = failures >= XONE_DONGLE_CH_FAILURE_LIMIT || losses ?
+		load : load - XONE_DONGLE_CH_LOAD_MARGIN;
+
+	/* the sweep or the last visit might be long ago */
+	if (ktime_ms_delta(ktime_get(), chan->surveyed) >
+	    XONE_DONGLE_CH_SURVEY_AGE) {
+		mutex_lock(&dongle->pairing_lock);
+		err = xone_mt76_survey_candidate(mt, chan);
+		mutex_unlock(&dongle->pairing_lock);
+		if (err)
+			return err;
+	}
+
+	if (xone_mt76_get_channel_load(chan) > limit)
+		return 0;
+
+	mutex_lock(&xone_dongle_list_lock);
+
+	/* another dongle might have moved to the channel meanwhile */
+	xone_dongle_avoid_channels(dongle);
+	if (xone_mt76_channel_used(mt, chan)) {
+		mutex_unlock(&xone_dongle_list_lock);
+		return 0;
+	}
+
+	mutex_lock(&dongle->pairing_lock);
+	dongle->channel_degraded = 0;
+	err = xone_mt76_change_channel(mt, chan, dongle->pairing);
+	if (!err)
+		dongle->channel_switches++;
+
+	mutex_unlock(&dongle->pairing_lock);
+	mutex_unlock(&xone_dongle_list_lock);
+
+	return err;
+}
+
+static int xone_dongle_get_load(struct xone_dongle *dongle)
+{
+	return atomic_read(&dongle->client_count) * XONE_DONGLE_CLIENT_LOAD +
+	       xone_mt76_get_channel_load(dongle->mt.channel);
+}
+
+static int xone_dongle_steer_pairing(struct xone_dongle *dongle)
+{
+	struct xone_dongle *target = dongle;
+	struct xone_dongle *other;
+	struct usb_interface *intf;
+	int err;
+
+	mutex_lock(&xone_dongle_list_lock);
+
+	/* dongles are listed before their radio is ready */
+	if (READ_ONCE(xone_dongle_pairing_steering) &&
+	    !list_empty(&dongle->node)) {
+		list_for_each_entry(other, &xone_dongle_list, node)
+			if (READ_ONCE(other->ready) &&
+			    xone_dongle_get_load(other) <
+			    xone_dongle_get_load(target))
+				target = other;
+	}
+
+	if (target != dongle)
+		dev_dbg(dongle->mt.dev, "%s: pairing on %s\n", __func__,
+			dev_name(target->mt.dev));
+
+	/* resuming here could wait for a suspend that waits for this lock */
+	intf = to_usb_interface(target->mt.dev);
+	err = usb_autopm_get_interface_async(intf);
+	if (err)
+		goto err_unlock;
+
+	/* a pending request already holds a reference */
+	if (!queue_work(system_wq, &target->steer_work))
+		usb_autopm_put_interface_async(intf);
+
+err_unlock:
+	mutex_unlock(&xone_dongle_list_lock);
+
+	return err;
+}
+
+static void xone_dongle_start_pairing(struct work_struct *work)
+{
+	struct xone_dongle *dongle = container_of(work, typeof(*dongle),
+						  steer_work);
+	struct usb_interface *intf = to_usb_interface(dongle->mt.dev);
+	int err;
+
+	/* wait for the resume requested by the steering dongle */
+	err = usb_autopm_get_interface(intf);
+	if (!err) {
+		mod_delayed_work(system_wq, &dongle->pairing_work,
+				 XONE_DONGLE_PAIRING_TIMEOUT);
+		err = xone_dongle_toggle_pairing(dongle, true);
+		usb_autopm_put_interface(intf);
+	}
+
+	if (err)
+		dev_err(dongle->mt.dev, "%s: enable pairing failed: %d\n",
+			__func__, err);
+
+	/* reference taken by the steering dongle */
+	usb_autopm_put_interface(intf);
+}
+
+static ssize_t tx_queued_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", READ_ONCE(client->tx_queued));
+}
+
+static ssize_t tx_drops_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(client->tx_drops));
+}
+
+static ssize_t audio_underruns_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(client->audio_underruns));
+}
+
+static ssize_t audio_overruns_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(client->audio_overruns));
+}
+
+static DEVICE_ATTR_RO(tx_queued);
+static DEVICE_ATTR_RO(tx_drops);
+static DEVICE_ATTR_RO(audio_underruns);
+static DEVICE_ATTR_RO(audio_overruns);
+
+static struct attribute *xone_dongle_client_attrs[] = {
+	&dev_attr_tx_queued.attr,
+	&dev_attr_tx_drops.attr,
+	&dev_attr_audio_underruns.attr,
+	&dev_attr_audio_overruns.attr,
+	NULL,
+};
+
+static const struct attribute_group xone_dongle_client_attr_group = {
+	.attrs = xone_dongle_client_attrs,
+};
+
+static ssize_t rssi_show(struct device *dev,
+			 struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+	long rssi = ewma_xone_signal_read(&client->link_rssi);
+
+	return sprintf(buf, "%ld\n", -rssi);
+}
+
+static ssize_t phy_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+	u16 rate = READ_ONCE(client->link_rate);
+
+	return sprintf(buf, "%lu\n", FIELD_GET(MT_RXWI_RATE_PHY, rate));
+}
+
+static ssize_t rate_show(struct device *dev,
+			 struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+	u16 rate = READ_ONCE(client->link_rate);
+
+	return sprintf(buf, "%lu\n", FIELD_GET(MT_RXWI_RATE_INDEX, rate));
+}
+
+static ssize_t frames_show(struct device *dev,
+			   struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(client->link_frames));
+}
+
+static ssize_t retries_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(client->link_retries));
+}
+
+static ssize_t lost_show(struct device *dev,
+			 struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle_client *client = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(client->link_lost));
+}
+
+static DEVICE_ATTR_RO(rssi);
+static DEVICE_ATTR_RO(phy);
+static DEVICE_ATTR_RO(rate);
+static DEVICE_ATTR_RO(frames);
+static DEVICE_ATTR_RO(retries);
+static DEVICE_ATTR_RO(lost);
+
+static struct attribute *xone_dongle_link_attrs[] = {
+	&dev_attr_rssi.attr,
+	&dev_attr_phy.attr,
+	&dev_attr_rate.attr,
+	&dev_attr_frames.attr,
+	&dev_attr_retries.attr,
+	&dev_attr_lost.attr,
+	NULL,
+};
+
+static const struct attribute_group xone_dongle_link_attr_group = {
+	.name = "link",
+	.attrs = xone_dongle_link_attrs,
+};
+
+static const struct attribute_group *xone_dongle_client_attr_groups[] = {
+	&xone_dongle_client_attr_group,
+	&xone_dongle_link_attr_group,
+	NULL,
+};
+
 static struct xone_dongle_client *
 xone_dongle_create_client(struct xone_dongle *dongle, u8 *addr)
 {
@@ -251,7 +1308,7 @@ xone_dongle_create_client(struct xone_dongle *dongle, u8 *addr)
 
 	/* find free WCID */
 	for (i = 0; i < XONE_DONGLE_MAX_CLIENTS; i++)
-		if (!dongle->clients[i])
+		if (!rcu_access_pointer(dongle->clients[i]))
 			break;
 
 	if (i == XONE_DONGLE_MAX_CLIENTS)
@@ -264,6 +1321,15 @@ xone_dongle_create_client(struct xone_dongle *dongle, u8 *addr)
 	client->dongle = dongle;
 	client->wcid = i + 1;
 	memcpy(client->address, addr, ETH_ALEN);
+	kref_init(&client->ref);
+	init_completion(&client->released);
+	INIT_LIST_HEAD(&client->tx_node);
+	init_usb_anchor(&client->urbs_audio_idle);
+	init_usb_anchor(&client->urbs_audio_busy);
+	spin_lock_init(&client->audio_lock);
+	hrtimer_init(&client->audio_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	client->audio_timer.function = xone_dongle_release_audio;
+	ewma_xone_signal_init(&client->link_rssi);
 
 	client->adapter = gip_create_adapter(dongle->mt.dev,
 					     &xone_dongle_adapter_ops, 1);
@@ -275,9 +1341,81 @@ xone_dongle_create_client(struct xone_dongle *dongle, u8 *addr)
 
 	dev_set_drvdata(&client->adapter->dev, client);
 
+	err = sysfs_create_groups(&client->adapter->dev.kobj,
+				  xone_dongle_client_attr_groups);
+	if (err) {
+		gip_destroy_adapter(client->adapter);
+		kfree(client);
+		return ERR_PTR(err);
+	}
+
+	return client;
+}
+
+static void xone_dongle_release_client(struct kref *ref)
+{
+	struct xone_dongle_client *client = container_of(ref, typeof(*client),
+							 ref);
+
+	complete(&client->released);
+}
+
+static struct xone_dongle_client *
+xone_dongle_get_client(struct xone_dongle *dongle, u8 wcid)
+{
+	struct xone_dongle_client *client;
+
+	rcu_read_lock();
+
+	client = rcu_dereference(dongle->clients[wcid - 1]);
+	if (client && !kref_get_unless_zero(&client->ref))
+		client = NULL;
+
+	rcu_read_unlock();
+
+	return client;
+}
+
+static void xone_dongle_put_client(struct xone_dongle_client *client)
+{
+	kref_put(&client->ref, xone_dongle_release_client);
+}
+
+static struct xone_dongle_client *
+xone_dongle_unpublish_client(struct xone_dongle *dongle, u8 wcid)
+{
+	struct xone_dongle_client *client;
+	spinlock_t *lock = &dongle->clients_lock;
+	unsigned long flags;
+
+	spin_lock_irqsave(lock, flags);
+	client = rcu_dereference_protected(dongle->clients[wcid - 1],
+					   lockdep_is_held(lock));
+	RCU_INIT_POINTER(dongle->clients[wcid - 1], NULL);
+	spin_unlock_irqrestore(lock, flags);
+
+	if (!client)
+		return NULL;
+
+	/* wait for lookups and RX processing to finish */
+	synchronize_rcu();
+	xone_dongle_put_client(client);
+	wait_for_completion(&client->released);
+
 	return client;
 }
 
+static void xone_dongle_destroy_client(struct xone_dongle_client *client)
+{
+	sysfs_remove_groups(&client->adapter->dev.kobj,
+			    xone_dongle_client_attr_groups);
+	gip_destroy_adapter(client->adapter);
+
+	/* drop messages queued during adapter removal */
+	xone_dongle_purge_tx(client);
+	kfree(client);
+}
+
 static int xone_dongle_add_client(struct xone_dongle *dongle, u8 *addr)
 {
 	struct xone_dongle_client *client;
@@ -302,7 +1440,7 @@ static int xone_dongle_add_client(struct xone_dongle *dongle, u8 *addr)
 		__func__, client->wcid, addr);
 
 	spin_lock_irqsave(&dongle->clients_lock, flags);
-	dongle->clients[client->wcid - 1] = client;
+	rcu_assign_pointer(dongle->clients[client->wcid - 1], client);
 	spin_unlock_irqrestore(&dongle->clients_lock, flags);
 
 	atomic_inc(&dongle->client_count);
@@ -311,8 +1449,7 @@ static int xone_dongle_add_client(struct xone_dongle *dongle, u8 *addr)
 	return 0;
 
 err_free_client:
-	gip_destroy_adapter(client->adapter);
-	kfree(client);
+	xone_dongle_destroy_client(client);
 
 	return err;
 }
@@ -321,21 +1458,15 @@ static int xone_dongle_remove_client(struct xone_dongle *dongle, u8 wcid)
 {
 	struct xone_dongle_client *client;
 	int err;
-	unsigned long flags;
 
-	client = dongle->clients[wcid - 1];
+	client = xone_dongle_unpublish_client(dongle, wcid);
 	if (!client)
 		return 0;
 
 	dev_dbg(dongle->mt.dev, "%s: wcid=%d, address=%pM\n",
 		__func__, wcid, client->address);
 
-	spin_lock_irqsave(&dongle->clients_lock, flags);
-	dongle->clients[wcid - 1] = NULL;
-	spin_unlock_irqrestore(&dongle->clients_lock, flags);
-
-	gip_destroy_adapter(client->adapter);
-	kfree(client);
+	xone_dongle_destroy_client(client);
 
 	err = xone_mt76_remove_client(&dongle->mt, wcid);
 	if (err)
@@ -365,228 +1496,356 @@ static int xone_dongle_pair_client(struct xone_dongle *dongle, u8 *addr)
 	return xone_dongle_toggle_pairing(dongle, false);
 }
 
-static void xone_dongle_handle_event(struct work_struct *work)
+static void xone_dongle_handle_event(struct xone_dongle *dongle,
+				     struct xone_dongle_event *evt)
 {
-	struct xone_dongle_event *evt = container_of(work, typeof(*evt), work);
 	int err;
 
 	switch (evt->type) {
 	case XONE_DONGLE_EVT_ADD_CLIENT:
-		err = xone_dongle_add_client(evt->dongle, evt->address);
+		err = xone_dongle_add_client(dongle, evt->address);
 		break;
 	case XONE_DONGLE_EVT_REMOVE_CLIENT:
-		err = xone_dongle_remove_client(evt->dongle, evt->wcid);
+		err = xone_dongle_remove_client(dongle, evt->wcid);
 		break;
 	case XONE_DONGLE_EVT_PAIR_CLIENT:
-		err = xone_dongle_pair_client(evt->dongle, evt->address);
+		err = xone_dongle_pair_client(dongle, evt->address);
 		break;
 	case XONE_DONGLE_EVT_ENABLE_PAIRING:
-		mod_delayed_work(system_wq, &evt->dongle->pairing_work,
-				 XONE_DONGLE_PAIRING_TIMEOUT);
-		err = xone_dongle_toggle_pairing(evt->dongle, true);
+		err = xone_dongle_steer_pairing(dongle);
+		break;
+	case XONE_DONGLE_EVT_MONITOR_CHANNEL:
+		err = xone_dongle_monitor_channel(dongle);
 		break;
 	}
 
 	if (err)
-		dev_err(evt->dongle->mt.dev, "%s: handle event failed: %d\n",
+		dev_err(dongle->mt.dev, "%s: handle event failed: %d\n",
 			__func__, err);
+}
+
+static void xone_dongle_process_events(struct work_struct *work)
+{
+	struct xone_dongle *dongle = container_of(work, typeof(*dongle),
+						  event_work);
+	struct xone_dongle_event evt;
+	unsigned long flags;
+
+	/* work items are non-reentrant, events are handled in order */
+	for (;;) {
+		spin_lock_irqsave(&dongle->events_lock, flags);
+
+		if (!dongle->events_count) {
+			spin_unlock_irqrestore(&dongle->events_lock, flags);
+			break;
+		}
+
+		/* copy frees the slot before the event is handled */
+		evt = dongle->events[dongle->events_head];
+		dongle->events_head = (dongle->events_head + 1) %
+				      XONE_DONGLE_NUM_EVENTS;
+		dongle->events_count--;
 
-	kfree(evt);
+		spin_unlock_irqrestore(&dongle->events_lock, flags);
+
+		xone_dongle_handle_event(dongle, &evt);
+	}
 }
 
-static struct xone_dongle_event *
-xone_dongle_alloc_event(struct xone_dongle *dongle,
-			enum xone_dongle_event_type type)
+static bool xone_dongle_is_membership_event(struct xone_dongle_event *evt)
 {
-	struct xone_dongle_event *evt;
+	return evt->type == XONE_DONGLE_EVT_ADD_CLIENT ||
+	       evt->type == XONE_DONGLE_EVT_REMOVE_CLIENT;
+}
 
-	evt = kzalloc(sizeof(*evt), GFP_ATOMIC);
-	if (!evt)
-		return NULL;
+static bool xone_dongle_merge_event(struct xone_dongle *dongle,
+				    struct xone_dongle_event *evt)
+{
+	struct xone_dongle_event *prev;
+	int i;
 
-	evt->type = type;
-	evt->dongle = dongle;
-	INIT_WORK(&evt->work, xone_dongle_handle_event);
+	/* newest to oldest, without reordering adds and removes */
+	for (i = dongle->events_count - 1; i >= 0; i--) {
+		prev = &dongle->events[(dongle->events_head + i) %
+				       XONE_DONGLE_NUM_EVENTS];
 
-	return evt;
+		if (prev->type == evt->type &&
+		    prev->wcid == evt->wcid &&
+		    ether_addr_equal(prev->address, evt->address))
+			return true;
+
+		if (xone_dongle_is_membership_event(prev) &&
+		    xone_dongle_is_membership_event(evt))
+			break;
+	}
+
+	return false;
 }
 
-static int xone_dongle_handle_qos_data(struct xone_dongle *dongle,
-				       struct sk_buff *skb, u8 wcid)
+static int xone_dongle_queue_event(struct xone_dongle *dongle,
+				   enum xone_dongle_event_type type,
+				   u8 *addr, u8 wcid)
 {
-	struct xone_dongle_client *client;
-	int err = 0;
+	struct xone_dongle_event evt = {
+		.type = type,
+		.wcid = wcid,
+	};
 	unsigned long flags;
+	int tail;
 
-	if (!wcid || wcid > XONE_DONGLE_MAX_CLIENTS)
+	if (addr)
+		memcpy(evt.address, addr, ETH_ALEN);
+
+	spin_lock_irqsave(&dongle->events_lock, flags);
+
+	if (xone_dongle_merge_event(dongle, &evt)) {
+		spin_unlock_irqrestore(&dongle->events_lock, flags);
 		return 0;
+	}
 
-	spin_lock_irqsave(&dongle->clients_lock, flags);
+	if (dongle->events_count == XONE_DONGLE_NUM_EVENTS) {
+		dongle->events_dropped++;
+		spin_unlock_irqrestore(&dongle->events_lock, flags);
+		return -ENOSPC;
+	}
 
-	client = dongle->clients[wcid - 1];
-	if (client)
-		err = gip_process_buffer(client->adapter, skb->data, skb->len);
+	tail = (dongle->events_head + dongle->events_count++) %
+	       XONE_DONGLE_NUM_EVENTS;
+	dongle->events[tail] = evt;
 
-	spin_unlock_irqrestore(&dongle->clients_lock, flags);
+	spin_unlock_irqrestore(&dongle->events_lock, flags);
 
-	return err;
+	queue_work(system_wq, &dongle->event_work);
+
+	return 0;
 }
 
-static int xone_dongle_handle_association(struct xone_dongle *dongle, u8 *addr)
+static void xone_dongle_channel_timeout(struct work_struct *work)
 {
-	struct xone_dongle_event *evt;
+	struct xone_dongle *dongle = container_of(to_delayed_work(work),
+						  typeof(*dongle),
+						  channel_work);
 
-	evt = xone_dongle_alloc_event(dongle, XONE_DONGLE_EVT_ADD_CLIENT);
-	if (!evt)
-		return -ENOMEM;
+	/* device can be suspended without clients */
+	if (atomic_read(&dongle->client_count))
+		xone_dongle_queue_event(dongle,
+					XONE_DONGLE_EVT_MONITOR_CHANNEL,
+					NULL, 0);
+
+	queue_delayed_work(system_wq, &dongle->channel_work,
+			   XONE_DONGLE_CH_MONITOR_INTERVAL);
+}
 
-	memcpy(evt->address, addr, ETH_ALEN);
+static void xone_dongle_update_link(struct xone_dongle_client *client,
+				    struct mt76_rxwi *rxwi,
+				    struct ieee80211_hdr_3addr *hdr)
+{
+	u16 tid_sn = le16_to_cpu(rxwi->tid_sn);
+	u8 tid = FIELD_GET(MT_RXWI_TID, tid_sn);
+	u16 sn = FIELD_GET(MT_RXWI_SN, tid_sn);
+	u16 rate = le16_to_cpu(rxwi->rate);
+	int rssi = xone_mt76_get_rssi(&client->dongle->mt, rxwi->rssi[0]);
+	bool retry = ieee80211_has_retry(hdr->frame_control);
+	u16 gap = 0;
+
+	/* RSSI of the first chain, averaged as attenuation */
+	ewma_xone_signal_add(&client->link_rssi, max(-rssi, 0));
+	WRITE_ONCE(client->link_rate, rate);
+
+	/* gaps in the sequence numbers of a TID are lost frames */
+	if (client->link_sn_valid & BIT(tid)) {
+		gap = (sn - client->link_sn[tid] - 1) & IEEE80211_SN_MASK;
+
+		/* repeated or reordered frames */
+		if (gap >= IEEE80211_SN_MODULO / 2) {
+			retry |= sn == client->link_sn[tid];
+			gap = 0;
+		}
+	}
 
-	queue_work(dongle->event_wq, &evt->work);
+	client->link_sn[tid] = sn;
+	client->link_sn_valid |= BIT(tid);
+	client->link_frames++;
+	client->link_lost += gap;
 
-	return 0;
+	if (retry)
+		client->link_retries++;
+
+	atomic_inc(&client->dongle->channel_frames);
+	if (gap)
+		atomic_add(gap, &client->dongle->channel_gaps);
+
+	trace_xone_dongle_rx_link(client->address, client->wcid, rssi,
+				  FIELD_GET(MT_RXWI_RATE_PHY, rate),
+				  FIELD_GET(MT_RXWI_RATE_INDEX, rate),
+				  sn, retry, gap);
 }
 
-static int xone_dongle_handle_disassociation(struct xone_dongle *dongle,
-					     u8 wcid)
+static int xone_dongle_handle_qos_data(struct xone_dongle *dongle,
+				       struct mt76_rxwi *rxwi,
+				       struct ieee80211_hdr_3addr *hdr,
+				       u8 *data, int len)
 {
-	struct xone_dongle_event *evt;
+	struct xone_dongle_client *client;
+	u8 wcid = FIELD_GET(MT_RXWI_CTL_WCID, le32_to_cpu(rxwi->ctl));
+	int err = 0;
 
 	if (!wcid || wcid > XONE_DONGLE_MAX_CLIENTS)
 		return 0;
 
-	evt = xone_dongle_alloc_event(dongle, XONE_DONGLE_EVT_REMOVE_CLIENT);
-	if (!evt)
-		return -ENOMEM;
+	client = xone_dongle_get_client(dongle, wcid);
+	if (!client)
+		return 0;
 
-	evt->wcid = wcid;
+	xone_dongle_update_link(client, rxwi, hdr);
 
-	queue_work(dongle->event_wq, &evt->work);
+	/* audio samples are released by xone_dongle_release_audio */
+	if (!gip_is_audio_packet(data, len) ||
+	    !xone_dongle_queue_audio(client, data, len))
+		err = gip_process_buffer(client->adapter, data, len);
 
-	return 0;
+	xone_dongle_put_client(client);
+
+	return err;
 }
 
-static int xone_dongle_handle_reserved(struct xone_dongle *dongle,
-				       struct sk_buff *skb, u8 *addr)
+static int xone_dongle_handle_association(struct xone_dongle *dongle, u8 *addr)
 {
-	struct xone_dongle_event *evt;
-
-	if (skb->len < 2)
-		return -EINVAL;
+	return xone_dongle_queue_event(dongle, XONE_DONGLE_EVT_ADD_CLIENT,
+				       addr, 0);
+}
 
-	if (skb->data[1] != 0x01)
+static int xone_dongle_handle_disassociation(struct xone_dongle *dongle,
+					     u8 wcid)
+{
+	if (!wcid || wcid > XONE_DONGLE_MAX_CLIENTS)
 		return 0;
 
-	evt = xone_dongle_alloc_event(dongle, XONE_DONGLE_EVT_PAIR_CLIENT);
-	if (!evt)
-		return -ENOMEM;
+	return xone_dongle_queue_event(dongle, XONE_DONGLE_EVT_REMOVE_CLIENT,
+				       NULL, wcid);
+}
 
-	memcpy(evt->address, addr, ETH_ALEN);
+static int xone_dongle_handle_reserved(struct xone_dongle *dongle,
+				       u8 *data, int len, u8 *addr)
+{
+	if (len < 2)
+		return -EINVAL;
 
-	queue_work(dongle->event_wq, &evt->work);
+	if (data[1] != 0x01)
+		return 0;
 
-	return 0;
+	return xone_dongle_queue_event(dongle, XONE_DONGLE_EVT_PAIR_CLIENT,
+				       addr, 0);
 }
 
 static int xone_dongle_handle_button(struct xone_dongle *dongle)
 {
-	struct xone_dongle_event *evt;
-
-	evt = xone_dongle_alloc_event(dongle, XONE_DONGLE_EVT_ENABLE_PAIRING);
-	if (!evt)
-		return -ENOMEM;
-
-	queue_work(dongle->event_wq, &evt->work);
-
-	return 0;
+	return xone_dongle_queue_event(dongle, XONE_DONGLE_EVT_ENABLE_PAIRING,
+				       NULL, 0);
 }
 
 static int xone_dongle_handle_loss(struct xone_dongle *dongle,
-				   struct sk_buff *skb)
+				   u8 *data, int len)
 {
 	u8 wcid;
 
-	if (skb->len < sizeof(wcid))
+	if (len < sizeof(wcid))
 		return -EINVAL;
 
-	wcid = skb->data[0];
+	wcid = data[0];
 	if (!wcid || wcid > XONE_DONGLE_MAX_CLIENTS)
 		return 0;
 
 	dev_dbg(dongle->mt.dev, "%s: wcid=%d\n", __func__, wcid);
 
+	atomic_inc(&dongle->channel_losses);
+
 	return xone_dongle_handle_disassociation(dongle, wcid);
 }
 
 static int xone_dongle_process_frame(struct xone_dongle *dongle,
-				     struct sk_buff *skb,
-				     unsigned int hdr_len, u8 wcid)
+				     struct mt76_rxwi *rxwi,
+				     u8 *data, int len,
+				     unsigned int hdr_len, unsigned int pad)
 {
-	struct ieee80211_hdr_3addr *hdr =
-		(struct ieee80211_hdr_3addr *)skb->data;
+	struct ieee80211_hdr_3addr *hdr = (struct ieee80211_hdr_3addr *)data;
+	u8 wcid = FIELD_GET(MT_RXWI_CTL_WCID, le32_to_cpu(rxwi->ctl));
 	u16 type;
 
 	/* ignore invalid frames */
-	if (skb->len < hdr_len || hdr_len < sizeof(*hdr))
+	if (len < hdr_len || hdr_len < sizeof(*hdr))
 		return 0;
 
-	skb_pull(skb, hdr_len);
+	/* payload follows the padding */
+	data += hdr_len + pad;
+	len -= hdr_len;
 	type = le16_to_cpu(hdr->frame_control);
 
 	switch (type & (IEEE80211_FCTL_FTYPE | IEEE80211_FCTL_STYPE)) {
 	case IEEE80211_FTYPE_DATA | IEEE80211_STYPE_QOS_DATA:
-		return xone_dongle_handle_qos_data(dongle, skb, wcid);
+		return xone_dongle_handle_qos_data(dongle, rxwi, hdr,
+						   data, len);
 	case IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_ASSOC_REQ:
 		return xone_dongle_handle_association(dongle, hdr->addr2);
 	case IEEE80211_FTYPE_MGMT | IEEE80211_STYPE_DISASSOC:
 		return xone_dongle_handle_disassociation(dongle, wcid);
 	case IEEE80211_FTYPE_MGMT | XONE_MT_WLAN_RESERVED:
-		return xone_dongle_handle_reserved(dongle, skb, hdr->addr2);
+		return xone_dongle_handle_reserved(dongle, data, len,
+						   hdr->addr2);
 	}
 
 	return 0;
 }
 
 static int xone_dongle_process_wlan(struct xone_dongle *dongle,
-				    struct sk_buff *skb)
+				    u8 *data, int len)
 {
-	struct mt76_rxwi *rxwi = (struct mt76_rxwi *)skb->data;
-	unsigned int hdr_len;
+	struct mt76_rxwi *rxwi = (struct mt76_rxwi *)data;
+	struct ieee80211_hdr *hdr;
+	unsigned int hdr_len = 0, pad = 0;
 	u32 ctl;
 
-	if (skb->len < sizeof(*rxwi))
+	if (len < sizeof(*rxwi))
 		return -EINVAL;
 
-	skb_pull(skb, sizeof(*rxwi));
-	hdr_len = ieee80211_get_hdrlen_from_skb(skb);
+	data += sizeof(*rxwi);
+	len -= sizeof(*rxwi);
+
+	/* frames are parsed in place, without copying */
+	hdr = (struct ieee80211_hdr *)data;
+	if (len >= offsetof(struct ieee80211_hdr, addr1) + ETH_ALEN) {
+		hdr_len = ieee80211_hdrlen(hdr->frame_control);
+		if (hdr_len > len)
+			hdr_len = 0;
+	}
 
 	/* 2 bytes of padding after 802.11 header */
 	if (rxwi->rxinfo & cpu_to_le32(MT_RXINFO_L2PAD)) {
-		if (skb->len < hdr_len + 2)
+		if (len < hdr_len + 2)
 			return -EINVAL;
 
-		memmove(skb->data + 2, skb->data, hdr_len);
-		skb_pull(skb, 2);
+		pad = 2;
+		len -= pad;
 	}
 
 	ctl = le32_to_cpu(rxwi->ctl);
-	skb_trim(skb, FIELD_GET(MT_RXWI_CTL_MPDU_LEN, ctl));
+	len = min_t(int, len, FIELD_GET(MT_RXWI_CTL_MPDU_LEN, ctl));
 
-	return xone_dongle_process_frame(dongle, skb, hdr_len,
-					 FIELD_GET(MT_RXWI_CTL_WCID, ctl));
+	return xone_dongle_process_frame(dongle, rxwi, data, len,
+					 hdr_len, pad);
 }
 
 static int xone_dongle_process_message(struct xone_dongle *dongle,
-				       struct sk_buff *skb)
+				       u8 *data, int len)
 {
 	enum mt76_dma_msg_port port;
 	u32 info;
 
 	/* command header + trailer */
-	if (skb->len < MT_CMD_HDR_LEN * 2)
+	if (len < MT_CMD_HDR_LEN * 2)
 		return -EINVAL;
 
-	info = get_unaligned_le32(skb->data);
+	info = get_unaligned_le32(data);
 	port = FIELD_GET(MT_RX_FCE_INFO_D_PORT, info);
 
 	/* ignore command reponses */
@@ -594,11 +1853,11 @@ static int xone_dongle_process_message(struct xone_dongle *dongle,
 		return 0;
 
 	/* remove header + trailer */
-	skb_pull(skb, MT_CMD_HDR_LEN);
-	skb_trim(skb, skb->len - MT_CMD_HDR_LEN);
+	data += MT_CMD_HDR_LEN;
+	len -= MT_CMD_HDR_LEN * 2;
 
 	if (port == MT_WLAN_PORT)
-		return xone_dongle_process_wlan(dongle, skb);
+		return xone_dongle_process_wlan(dongle, data, len);
 
 	if (port != MT_CPU_RX_PORT)
 		return 0;
@@ -607,40 +1866,109 @@ static int xone_dongle_process_message(struct xone_dongle *dongle,
 	case XONE_MT_EVT_BUTTON:
 		return xone_dongle_handle_button(dongle);
 	case XONE_MT_EVT_PACKET_RX:
-		return xone_dongle_process_wlan(dongle, skb);
+		return xone_dongle_process_wlan(dongle, data, len);
 	case XONE_MT_EVT_CLIENT_LOST:
-		return xone_dongle_handle_loss(dongle, skb);
+		return xone_dongle_handle_loss(dongle, data, len);
+	}
+
+	return 0;
+}
+
+static int xone_dongle_process_buffer(struct xone_dongle *dongle,
+				      u8 *data, int len)
+{
+	int msg_len, ret, err = 0;
+
+	/* parsed directly from the URB buffer */
+	while (len) {
+		msg_len = len;
+
+		/* aggregated messages are prefixed with their length */
+		if (dongle->mt.rx_agg_limit && len >= MT_CMD_HDR_LEN * 2) {
+			msg_len = FIELD_GET(MT_RX_FCE_INFO_LEN,
+					    get_unaligned_le32(data));
+			msg_len += MT_CMD_HDR_LEN * 2;
+
+			/* treat the remainder as a single message */
+			if (msg_len == MT_CMD_HDR_LEN * 2 || msg_len > len)
+				msg_len = len;
+		}
+
+		ret = xone_dongle_process_message(dongle, data, msg_len);
+		if (ret) {
+			dev_err(dongle->mt.dev, "%s: process failed: %d\n",
+				__func__, ret);
+			print_hex_dump_debug("xone-dongle packet: ",
+					     DUMP_PREFIX_NONE, 16, 1,
+					     data, msg_len, false);
+			err = ret;
+		}
+
+		data += msg_len;
+		len -= msg_len;
 	}
 
-	return 0;
+	return err;
 }
 
-static int xone_dongle_process_buffer(struct xone_dongle *dongle,
-				      void *data, int len)
+static void xone_dongle_queue_rx(struct xone_dongle *dongle)
+{
+	int cpu = READ_ONCE(dongle->rx_cpu);
+
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu))
+		cpu = WORK_CPU_UNBOUND;
+
+	queue_work_on(cpu, system_highpri_wq, &dongle->rx_work);
+}
+
+static void xone_dongle_process_rx(struct work_struct *work)
 {
-	struct sk_buff *skb;
+	struct xone_dongle *dongle = container_of(work, typeof(*dongle),
+						  rx_work);
+	int budget = READ_ONCE(dongle->rx_budget) ?: XONE_DONGLE_MAX_RX_BUDGET;
+	struct urb *urb;
 	int err;
 
-	if (!len)
-		return 0;
+	/* anchor preserves the completion order */
+	while (budget-- && (urb = usb_get_from_anchor(&dongle->urbs_in_done))) {
+		err = xone_dongle_process_buffer(dongle, urb->transfer_buffer,
+						 urb->actual_length);
+		if (err)
+			dev_err(dongle->mt.dev, "%s: process failed: %d\n",
+				__func__, err);
 
-	skb = dev_alloc_skb(len);
-	if (!skb)
-		return -ENOMEM;
+		usb_anchor_urb(urb, &dongle->urbs_in_busy);
 
-	skb_put_data(skb, data, len);
+		/* can fail during USB device removal */
+		err = usb_submit_urb(urb, GFP_KERNEL);
+		if (err) {
+			dev_dbg(dongle->mt.dev, "%s: submit failed: %d\n",
+				__func__, err);
+			usb_unanchor_urb(urb);
+			usb_anchor_urb(urb, &dongle->urbs_in_idle);
+		}
 
-	err = xone_dongle_process_message(dongle, skb);
-	if (err) {
-		dev_err(dongle->mt.dev, "%s: process failed: %d\n",
-			__func__, err);
-		print_hex_dump_debug("xone-dongle packet: ", DUMP_PREFIX_NONE,
-				     16, 1, data, len, false);
+		usb_free_urb(urb);
 	}
 
-	dev_kfree_skb(skb);
+	/* yield to other work items if budget is exhausted */
+	if (!usb_anchor_empty(&dongle->urbs_in_done))
+		xone_dongle_queue_rx(dongle);
+}
 
-	return err;
+static void xone_dongle_stop_rx(struct xone_dongle *dongle)
+{
+	struct urb *urb;
+
+	/* RX work can resubmit URBs until it has been cancelled */
+	usb_kill_anchored_urbs(&dongle->urbs_in_busy);
+	cancel_work_sync(&dongle->rx_work);
+	usb_kill_anchored_urbs(&dongle->urbs_in_busy);
+
+	while ((urb = usb_get_from_anchor(&dongle->urbs_in_done))) {
+		usb_anchor_urb(urb, &dongle->urbs_in_idle);
+		usb_free_urb(urb);
+	}
 }
 
 static void xone_dongle_complete_in(struct urb *urb)
@@ -660,6 +1988,17 @@ static void xone_dongle_complete_in(struct urb *urb)
 		goto resubmit;
 	}
 
+	/*
+	 * Defer processing while previous buffers are pending or the work
+	 * still runs, so switching the budget to 0 never reorders packets.
+	 */
+	if (READ_ONCE(dongle->rx_budget) || work_busy(&dongle->rx_work) ||
+	    !usb_anchor_empty(&dongle->urbs_in_done)) {
+		usb_anchor_urb(urb, &dongle->urbs_in_done);
+		xone_dongle_queue_rx(dongle);
+		return;
+	}
+
 	err = xone_dongle_process_buffer(dongle, urb->transfer_buffer,
 					 urb->actual_length);
 	if (err)
@@ -680,11 +2019,28 @@ resubmit:
 
 static void xone_dongle_complete_out(struct urb *urb)
 {
-	struct sk_buff *skb = urb->context;
-	struct xone_dongle_skb_cb *cb = (struct xone_dongle_skb_cb *)skb->cb;
+	struct xone_dongle_tx_context *ctx = urb->context;
+	struct xone_dongle *dongle = ctx->dongle;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dongle->tx_lock, flags);
+	dongle->tx_inflight--;
+	xone_dongle_release_urb(dongle, urb);
+	xone_dongle_schedule_tx(dongle);
+	spin_unlock_irqrestore(&dongle->tx_lock, flags);
+}
+
+static void xone_dongle_complete_agg(struct urb *urb)
+{
+	struct xone_dongle_tx_context *ctx = urb->context;
+	struct xone_dongle *dongle = ctx->dongle;
+	unsigned long flags;
 
-	usb_anchor_urb(urb, &cb->dongle->urbs_out_idle);
-	dev_consume_skb_any(skb);
+	spin_lock_irqsave(&dongle->tx_lock, flags);
+	dongle->tx_inflight--;
+	usb_anchor_urb(urb, &dongle->urbs_agg_idle);
+	xone_dongle_schedule_tx(dongle);
+	spin_unlock_irqrestore(&dongle->tx_lock, flags);
 }
 
 static int xone_dongle_init_urbs_in(struct xone_dongle *dongle,
@@ -721,41 +2077,31 @@ static int xone_dongle_init_urbs_in(struct xone_dongle *dongle,
 	return 0;
 }
 
-static int xone_dongle_init_urbs_out(struct xone_dongle *dongle)
-{
-	struct xone_mt76 *mt = &dongle->mt;
-	struct urb *urb;
-	int i;
-
-	for (i = 0; i < XONE_DONGLE_NUM_OUT_URBS; i++) {
-		urb = usb_alloc_urb(0, GFP_KERNEL);
-		if (!urb)
-			return -ENOMEM;
-
-		usb_fill_bulk_urb(urb, mt->udev,
-				  usb_sndbulkpipe(mt->udev, XONE_MT_EP_OUT),
-				  NULL, 0, xone_dongle_complete_out, NULL);
-		usb_anchor_urb(urb, &dongle->urbs_out_idle);
-		usb_free_urb(urb);
-	}
-
-	return 0;
-}
-
 static int xone_dongle_init(struct xone_dongle *dongle)
 {
 	struct xone_mt76 *mt = &dongle->mt;
+	ktime_t start;
 	int err;
 
-	init_usb_anchor(&dongle->urbs_out_idle);
-	init_usb_anchor(&dongle->urbs_out_busy);
-	init_usb_anchor(&dongle->urbs_in_idle);
-	init_usb_anchor(&dongle->urbs_in_busy);
-
-	err = xone_dongle_init_urbs_out(dongle);
+	err = xone_dongle_init_urbs_out(dongle, dongle->tx_contexts,
+					&dongle->urbs_out_idle,
+					XONE_DONGLE_NUM_OUT_URBS,
+					XONE_DONGLE_LEN_OUT_BUF,
+					xone_dongle_complete_out);
 	if (err)
 		return err;
 
+	if (dongle->tx_delay) {
+		err = xone_dongle_init_urbs_out(dongle, dongle->tx_contexts +
+						XONE_DONGLE_NUM_OUT_URBS,
+						&dongle->urbs_agg_idle,
+						XONE_DONGLE_NUM_AGG_URBS,
+						XONE_DONGLE_LEN_AGG_BUF,
+						xone_dongle_complete_agg);
+		if (err)
+			return err;
+	}
+
 	err = xone_dongle_init_urbs_in(dongle, XONE_MT_EP_IN_CMD,
 				       XONE_DONGLE_LEN_CMD_PKT);
 	if (err)
@@ -766,6 +2112,8 @@ static int xone_dongle_init(struct xone_dongle *dongle)
 	if (err)
 		return err;
 
+	start = ktime_get();
+
 	err = xone_mt76_load_firmware(mt, "xow_dongle.bin");
 	if (err) {
 		dev_err(mt->dev, "%s: load firmware failed: %d\n",
@@ -774,10 +2122,29 @@ static int xone_dongle_init(struct xone_dongle *dongle)
 	}
 
 	err = xone_mt76_init_radio(mt);
-	if (err)
+	if (err) {
 		dev_err(mt->dev, "%s: init radio failed: %d\n", __func__, err);
+		return err;
+	}
 
-	return err;
+	/* listing the dongle reserves its channel */
+	mutex_lock(&xone_dongle_list_lock);
+	xone_dongle_avoid_channels(dongle);
+	xone_mt76_select_channel(mt);
+	list_add_tail(&dongle->node, &xone_dongle_list);
+	mutex_unlock(&xone_dongle_list_lock);
+
+	err = xone_mt76_start_radio(mt);
+	if (err) {
+		dev_err(mt->dev, "%s: start radio failed: %d\n",
+			__func__, err);
+		return err;
+	}
+
+	dev_dbg(mt->dev, "%s: firmware and radio ready in %lldus\n",
+		__func__, ktime_us_delta(ktime_get(), start));
+
+	return 0;
 }
 
 static int xone_dongle_power_off_clients(struct xone_dongle *dongle)
@@ -785,12 +2152,11 @@ static int xone_dongle_power_off_clients(struct xone_dongle *dongle)
 	struct xone_dongle_client *client;
 	int i;
 	int err = 0;
-	unsigned long flags;
 
-	spin_lock_irqsave(&dongle->clients_lock, flags);
+	rcu_read_lock();
 
 	for (i = 0; i < XONE_DONGLE_MAX_CLIENTS; i++) {
-		client = dongle->clients[i];
+		client = rcu_dereference(dongle->clients[i]);
 		if (!client)
 			continue;
 
@@ -799,7 +2165,7 @@ static int xone_dongle_power_off_clients(struct xone_dongle *dongle)
 			break;
 	}
 
-	spin_unlock_irqrestore(&dongle->clients_lock, flags);
+	rcu_read_unlock();
 
 	if (err)
 		return err;
@@ -819,24 +2185,23 @@ static void xone_dongle_destroy(struct xone_dongle *dongle)
 	struct urb *urb;
 	int i;
 
-	usb_kill_anchored_urbs(&dongle->urbs_in_busy);
-	destroy_workqueue(dongle->event_wq);
+	xone_dongle_stop_rx(dongle);
+	cancel_delayed_work_sync(&dongle->channel_work);
+	flush_work(&dongle->event_work);
+	cancel_work_sync(&dongle->steer_work);
 	cancel_delayed_work_sync(&dongle->pairing_work);
 
 	for (i = 0; i < XONE_DONGLE_MAX_CLIENTS; i++) {
-		client = dongle->clients[i];
-		if (!client)
-			continue;
-
-		gip_destroy_adapter(client->adapter);
-		kfree(client);
-		dongle->clients[i] = NULL;
+		client = xone_dongle_unpublish_client(dongle, i + 1);
+		if (client)
+			xone_dongle_destroy_client(client);
 	}
 
+	xone_dongle_stop_tx(dongle);
 	usb_kill_anchored_urbs(&dongle->urbs_out_busy);
 
-	while ((urb = usb_get_from_anchor(&dongle->urbs_out_idle)))
-		usb_free_urb(urb);
+	xone_dongle_free_urbs(&dongle->urbs_out_idle, XONE_DONGLE_LEN_OUT_BUF);
+	xone_dongle_free_urbs(&dongle->urbs_agg_idle, XONE_DONGLE_LEN_AGG_BUF);
 
 	while ((urb = usb_get_from_anchor(&dongle->urbs_in_idle))) {
 		usb_free_coherent(urb->dev, urb->transfer_buffer_length,
@@ -847,11 +2212,202 @@ static void xone_dongle_destroy(struct xone_dongle *dongle)
 	mutex_destroy(&dongle->pairing_lock);
 }
 
+static ssize_t rx_budget_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", READ_ONCE(dongle->rx_budget));
+}
+
+static ssize_t rx_budget_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+	unsigned int budget;
+	int err;
+
+	err = kstrtouint(buf, 10, &budget);
+	if (err)
+		return err;
+
+	if (budget > XONE_DONGLE_MAX_RX_BUDGET)
+		return -EINVAL;
+
+	WRITE_ONCE(dongle->rx_budget, budget);
+
+	return count;
+}
+
+static ssize_t rx_cpu_show(struct device *dev,
+			   struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%d\n", READ_ONCE(dongle->rx_cpu));
+}
+
+static ssize_t rx_cpu_store(struct device *dev,
+			    struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+	int cpu, err;
+
+	err = kstrtoint(buf, 10, &cpu);
+	if (err)
+		return err;
+
+	if (cpu < -1 || cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	WRITE_ONCE(dongle->rx_cpu, cpu);
+
+	return count;
+}
+
+static ssize_t tx_frames_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(dongle->tx_frames));
+}
+
+static ssize_t tx_transfers_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(dongle->tx_transfers));
+}
+
+static ssize_t tx_frames_per_transfer_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+	u64 frames = READ_ONCE(dongle->tx_frames);
+	u32 transfers = READ_ONCE(dongle->tx_transfers);
+	u32 rem;
+
+	if (!transfers)
+		return sprintf(buf, "0.00\n");
+
+	/* two decimal places */
+	frames = div_u64_rem(div_u64(frames * 100, transfers), 100, &rem);
+
+	return sprintf(buf, "%llu.%02u\n", frames, rem);
+}
+
+static ssize_t events_dropped_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(dongle->events_dropped));
+}
+
+static ssize_t channel_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(dongle->mt.channel)->index);
+}
+
+static ssize_t channel_load_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+	struct xone_mt76_channel *chan = READ_ONCE(dongle->mt.channel);
+
+	return sprintf(buf, "%d\n", xone_mt76_get_channel_load(chan));
+}
+
+static ssize_t channel_switches_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct xone_dongle *dongle = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(dongle->channel_switches));
+}
+
+static DEVICE_ATTR_RW(rx_budget);
+static DEVICE_ATTR_RW(rx_cpu);
+static DEVICE_ATTR_RO(tx_frames);
+static DEVICE_ATTR_RO(tx_transfers);
+static DEVICE_ATTR_RO(tx_frames_per_transfer);
+static DEVICE_ATTR_RO(events_dropped);
+static DEVICE_ATTR_RO(channel);
+static DEVICE_ATTR_RO(channel_load);
+static DEVICE_ATTR_RO(channel_switches);
+
+static struct attribute *xone_dongle_attrs[] = {
+	&dev_attr_rx_budget.attr,
+	&dev_attr_rx_cpu.attr,
+	&dev_attr_tx_frames.attr,
+	&dev_attr_tx_transfers.attr,
+	&dev_attr_tx_frames_per_transfer.attr,
+	&dev_attr_events_dropped.attr,
+	&dev_attr_channel.attr,
+	&dev_attr_channel_load.attr,
+	&dev_attr_channel_switches.attr,
+	NULL,
+};
+
+ATTRIBUTE_GROUPS(xone_dongle);
+
+static void xone_dongle_init_async(struct work_struct *work)
+{
+	struct xone_dongle *dongle = container_of(work, typeof(*dongle),
+						  init_work);
+	struct usb_interface *intf = to_usb_interface(dongle->mt.dev);
+	int err;
+
+	/* resources are released on disconnect */
+	err = xone_dongle_init(dongle);
+	if (err) {
+		dev_err(dongle->mt.dev, "%s: init failed: %d\n",
+			__func__, err);
+		goto err_reset_device;
+	}
+
+	dongle->ready = true;
+	queue_delayed_work(system_wq, &dongle->channel_work,
+			   XONE_DONGLE_CH_MONITOR_INTERVAL);
+
+	/* enable USB remote wakeup and autosuspend */
+	intf->needs_remote_wakeup = true;
+	device_wakeup_enable(&dongle->mt.udev->dev);
+	pm_runtime_set_autosuspend_delay(&dongle->mt.udev->dev,
+					 XONE_DONGLE_SUSPEND_DELAY);
+	usb_enable_autosuspend(dongle->mt.udev);
+	usb_autopm_put_interface(intf);
+
+	return;
+
+err_reset_device:
+	mutex_lock(&xone_dongle_list_lock);
+	list_del_init(&dongle->node);
+	mutex_unlock(&xone_dongle_list_lock);
+
+	/* suspend ignores dongles that are not ready */
+	xone_dongle_stop_rx(dongle);
+	usb_autopm_put_interface(intf);
+
+	/* rebinds the driver, disconnect waits for this work */
+	usb_queue_reset_device(intf);
+}
+
 static int xone_dongle_probe(struct usb_interface *intf,
 			     const struct usb_device_id *id)
 {
 	struct xone_dongle *dongle;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
 	int err;
+#endif
 
 	dongle = devm_kzalloc(&intf->dev, sizeof(*dongle), GFP_KERNEL);
 	if (!dongle)
@@ -862,29 +2418,53 @@ static int xone_dongle_probe(struct usb_interface *intf,
 
 	usb_reset_device(dongle->mt.udev);
 
-	dongle->event_wq = alloc_ordered_workqueue("xone_dongle", 0);
-	if (!dongle->event_wq)
-		return -ENOMEM;
+	if (xone_dongle_rx_aggregation)
+		dongle->mt.rx_agg_limit = XONE_DONGLE_RX_AGG_LIMIT;
 
+	init_usb_anchor(&dongle->urbs_out_idle);
+	init_usb_anchor(&dongle->urbs_out_busy);
+	init_usb_anchor(&dongle->urbs_out_pending);
+	init_usb_anchor(&dongle->urbs_agg_idle);
+	init_usb_anchor(&dongle->urbs_in_idle);
+	init_usb_anchor(&dongle->urbs_in_busy);
+	init_usb_anchor(&dongle->urbs_in_done);
+	INIT_WORK(&dongle->rx_work, xone_dongle_process_rx);
+	dongle->rx_budget = min_t(uint, xone_dongle_rx_budget,
+				  XONE_DONGLE_MAX_RX_BUDGET);
+	dongle->rx_cpu = xone_dongle_rx_cpu;
+	spin_lock_init(&dongle->tx_lock);
+	INIT_LIST_HEAD(&dongle->tx_active);
+	hrtimer_init(&dongle->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dongle->tx_timer.function = xone_dongle_tx_timeout;
+	dongle->tx_delay = us_to_ktime(xone_dongle_tx_aggregation);
+	spin_lock_init(&dongle->events_lock);
+	INIT_WORK(&dongle->event_work, xone_dongle_process_events);
 	mutex_init(&dongle->pairing_lock);
 	INIT_DELAYED_WORK(&dongle->pairing_work, xone_dongle_pairing_timeout);
+	INIT_WORK(&dongle->steer_work, xone_dongle_start_pairing);
+	INIT_DELAYED_WORK(&dongle->channel_work, xone_dongle_channel_timeout);
 	spin_lock_init(&dongle->clients_lock);
 	init_waitqueue_head(&dongle->disconnect_wait);
+	INIT_WORK(&dongle->init_work, xone_dongle_init_async);
+	INIT_LIST_HEAD(&dongle->node);
 
-	err = xone_dongle_init(dongle);
+	usb_set_intfdata(intf, dongle);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
+	/* added by the driver core on newer kernels */
+	err = sysfs_create_groups(&intf->dev.kobj, xone_dongle_groups);
 	if (err) {
+		usb_set_intfdata(intf, NULL);
 		xone_dongle_destroy(dongle);
 		return err;
 	}
+#endif
 
-	usb_set_intfdata(intf, dongle);
+	/* keep the device awake until initialization has finished */
+	usb_autopm_get_interface_no_resume(intf);
 
-	/* enable USB remote wakeup and autosuspend */
-	intf->needs_remote_wakeup = true;
-	device_wakeup_enable(&dongle->mt.udev->dev);
-	pm_runtime_set_autosuspend_delay(&dongle->mt.udev->dev,
-					 XONE_DONGLE_SUSPEND_DELAY);
-	usb_enable_autosuspend(dongle->mt.udev);
+	/* firmware upload and calibration would block the hub thread */
+	queue_work(system_unbound_wq, &dongle->init_work);
 
 	return 0;
 }
@@ -894,6 +2474,16 @@ static void xone_dongle_disconnect(struct usb_interface *intf)
 	struct xone_dongle *dongle = usb_get_intfdata(intf);
 	int err;
 
+	cancel_work_sync(&dongle->init_work);
+
+	mutex_lock(&xone_dongle_list_lock);
+	list_del_init(&dongle->node);
+	mutex_unlock(&xone_dongle_list_lock);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
+	sysfs_remove_groups(&intf->dev.kobj, xone_dongle_groups);
+#endif
+
 	/* can fail during USB device removal */
 	err = xone_dongle_power_off_clients(dongle);
 	if (err)
@@ -904,20 +2494,71 @@ static void xone_dongle_disconnect(struct usb_interface *intf)
 	usb_set_intfdata(intf, NULL);
 }
 
+static void xone_dongle_stop_audio(struct xone_dongle *dongle)
+{
+	struct xone_dongle_client *client;
+	int i;
+
+	for (i = 1; i <= XONE_DONGLE_MAX_CLIENTS; i++) {
+		client = xone_dongle_get_client(dongle, i);
+		if (!client)
+			continue;
+
+		spin_lock_irq(&client->audio_lock);
+		client->audio_stopped = true;
+		spin_unlock_irq(&client->audio_lock);
+
+		hrtimer_cancel(&client->audio_timer);
+		usb_kill_anchored_urbs(&client->urbs_audio_busy);
+		xone_dongle_put_client(client);
+	}
+}
+
+static void xone_dongle_start_audio(struct xone_dongle *dongle)
+{
+	struct xone_dongle_client *client;
+	int i;
+
+	for (i = 1; i <= XONE_DONGLE_MAX_CLIENTS; i++) {
+		client = xone_dongle_get_client(dongle, i);
+		if (!client)
+			continue;
+
+		spin_lock_irq(&client->audio_lock);
+		client->audio_stopped = false;
+
+		if (client->audio_in)
+			hrtimer_start(&client->audio_timer,
+				      ms_to_ktime(GIP_AUDIO_INTERVAL),
+				      HRTIMER_MODE_REL);
+
+		spin_unlock_irq(&client->audio_lock);
+		xone_dongle_put_client(client);
+	}
+}
+
 static int xone_dongle_suspend(struct usb_interface *intf, pm_message_t message)
 {
 	struct xone_dongle *dongle = usb_get_intfdata(intf);
 	int err;
 
+	flush_work(&dongle->init_work);
+
+	if (!dongle->ready)
+		return 0;
+
 	err = xone_dongle_power_off_clients(dongle);
 	if (err)
 		dev_err(dongle->mt.dev, "%s: power off failed: %d\n",
 			__func__, err);
 
-	usb_kill_anchored_urbs(&dongle->urbs_in_busy);
+	xone_dongle_stop_rx(dongle);
+	xone_dongle_stop_tx(dongle);
 	usb_kill_anchored_urbs(&dongle->urbs_out_busy);
-	flush_workqueue(dongle->event_wq);
+	cancel_delayed_work_sync(&dongle->channel_work);
+	flush_work(&dongle->event_work);
 	cancel_delayed_work_sync(&dongle->pairing_work);
+	xone_dongle_stop_audio(dongle);
 
 	return xone_mt76_suspend_radio(&dongle->mt);
 }
@@ -928,6 +2569,12 @@ static int xone_dongle_resume(struct usb_interface *intf)
 	struct urb *urb;
 	int err;
 
+	if (!dongle->ready)
+		return 0;
+
+	/* before RX can add clients */
+	xone_dongle_start_audio(dongle);
+
 	while ((urb = usb_get_from_anchor(&dongle->urbs_in_idle))) {
 		usb_anchor_urb(urb, &dongle->urbs_in_busy);
 		usb_free_urb(urb);
@@ -937,7 +2584,15 @@ static int xone_dongle_resume(struct usb_interface *intf)
 			return err;
 	}
 
-	return xone_mt76_resume_radio(&dongle->mt);
+	err = xone_mt76_resume_radio(&dongle->mt);
+	if (err)
+		return err;
+
+	xone_dongle_start_tx(dongle);
+	queue_delayed_work(system_wq, &dongle->channel_work,
+			   XONE_DONGLE_CH_MONITOR_INTERVAL);
+
+	return 0;
 }
 
 static void xone_dongle_shutdown(struct device *dev)
@@ -946,6 +2601,11 @@ static void xone_dongle_shutdown(struct device *dev)
 	struct xone_dongle *dongle = usb_get_intfdata(intf);
 	int err;
 
+	flush_work(&dongle->init_work);
+
+	if (!dongle->ready)
+		return;
+
 	err = xone_dongle_power_off_clients(dongle);
 	if (err)
 		dev_err(dongle->mt.dev, "%s: power off failed: %d\n",
@@ -967,13 +2627,82 @@ static struct usb_driver xone_dongle_driver = {
 	.suspend = xone_dongle_suspend,
 	.resume = xone_dongle_resume,
 	.id_table = xone_dongle_id_table,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+	.dev_groups = xone_dongle_groups,
+#endif
 	.drvwrap.driver.shutdown = xone_dongle_shutdown,
 	.supports_autosuspend = true,
 	.disable_hub_initiated_lpm = true,
 	.soft_unbind = true,
 };
 
-module_usb_driver(xone_dongle_driver);
+static int xone_dongle_clients_show(struct seq_file *s, void *data)
+{
+	struct xone_dongle *dongle;
+	struct xone_dongle_client *client;
+	struct xone_mt76_channel *chan;
+	long rssi;
+	int i;
+
+	mutex_lock(&xone_dongle_list_lock);
+
+	list_for_each_entry(dongle, &xone_dongle_list, node) {
+		chan = dongle->mt.channel;
+		seq_printf(s, "%s: address=%pM, channel=%u, load=%d, ",
+			   dev_name(dongle->mt.dev), dongle->mt.address,
+			   chan->index, xone_mt76_get_channel_load(chan));
+		seq_printf(s, "clients=%d, pairing=%d\n",
+			   atomic_read(&dongle->client_count),
+			   dongle->pairing);
+
+		rcu_read_lock();
+
+		for (i = 0; i < XONE_DONGLE_MAX_CLIENTS; i++) {
+			client = rcu_dereference(dongle->clients[i]);
+			if (!client)
+				continue;
+
+			rssi = ewma_xone_signal_read(&client->link_rssi);
+			seq_printf(s, "\twcid=%u, address=%pM, rssi=%ld, ",
+				   client->wcid, client->address, -rssi);
+			seq_printf(s, "lost=%u\n",
+				   READ_ONCE(client->link_lost));
+		}
+
+		rcu_read_unlock();
+	}
+
+	mutex_unlock(&xone_dongle_list_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(xone_dongle_clients);
+
+static int __init xone_dongle_init_module(void)
+{
+	int err;
+
+	/* placement of clients across all dongles */
+	xone_dongle_debugfs = debugfs_create_dir("xone-dongle", NULL);
+	debugfs_create_file("clients", 0444, xone_dongle_debugfs, NULL,
+			    &xone_dongle_clients_fops);
+
+	err = usb_register(&xone_dongle_driver);
+	if (err)
+		debugfs_remove_recursive(xone_dongle_debugfs);
+
+	return err;
+}
+
+static void __exit xone_dongle_exit_module(void)
+{
+	usb_deregister(&xone_dongle_driver);
+	debugfs_remove_recursive(xone_dongle_debugfs);
+	xone_mt76_free_firmware();
+}
+
+module_init(xone_dongle_init_module);
+module_exit(xone_dongle_exit_module);
 
 MODULE_DEVICE_TABLE(usb, xone_dongle_id_table);
 MODULE_AUTHOR("Severin von Wnuck <severinvonw@outlook.de>");
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2021 Severin von Wnuck <severinvonw@outlook.de>
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM xone_dongle
+
+#if !defined(_XONE_DONGLE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _XONE_DONGLE_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/if_ether.h>
+
+TRACE_EVENT(xone_dongle_rx_link,
+	TP_PROTO(u8 *addr, u8 wcid, int rssi, u8 phy, u8 rate, u16 sn,
+		 bool retry, u16 lost),
+	TP_ARGS(addr, wcid, rssi, phy, rate, sn, retry, lost),
+	TP_STRUCT__entry(
+		__array(u8, addr, ETH_ALEN)
+		__field(u8, wcid)
+		__field(int, rssi)
+		__field(u8, phy)
+		__field(u8, rate)
+		__field(u16, sn)
+		__field(bool, retry)
+		__field(u16, lost)
+	),
+	TP_fast_assign(
+		memcpy(__entry->addr, addr, ETH_ALEN);
+		__entry->wcid = wcid;
+		__entry->rssi = rssi;
+		__entry->phy = phy;
+		__entry->rate = rate;
+		__entry->sn = sn;
+		__entry->retry = retry;
+		__entry->lost = lost;
+	),
+	TP_printk("addr=%pM wcid=%u rssi=%d phy=%u rate=%u sn=%u retry=%d "
+		  "lost=%u",
+		  __entry->addr, __entry->wcid, __entry->rssi, __entry->phy,
+		  __entry->rate, __entry->sn, __entry->retry, __entry->lost)
+);
+
+#endif /* _XONE_DONGLE_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE dongle_trace
+
+#include <trace/define_trace.h>
@@ -8,6 +8,10 @@
 #include <linux/delay.h>
 #include <linux/usb.h>
 #include <linux/firmware.h>
+#include <linux/etherdevice.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/sort.h>
 #include <linux/ieee80211.h>
 
 #include "mt76.h"
@@ -15,13 +19,26 @@
 /* bulk transfer timeout in ms */
 #define XONE_MT_USB_TIMEOUT 1000
 
-#define XONE_MT_POLL_RETRIES 50
+/* register polling timeout and backoff in us */
+#define XONE_MT_POLL_TIMEOUT 1000000
+#define XONE_MT_POLL_DELAY_MIN 20
+#define XONE_MT_POLL_DELAY_MAX 10000
 
 #define XONE_MT_RF_PATCH 0x0130
 #define XONE_MT_FW_LOAD_IVB 0x12
 #define XONE_MT_FW_ILM_OFFSET 0x080000
 #define XONE_MT_FW_DLM_OFFSET 0x110800
 #define XONE_MT_FW_CHUNK_SIZE 0x3800
+#define XONE_MT_FW_BUF_SIZE (XONE_MT_FW_CHUNK_SIZE + MT_CMD_HDR_LEN * 2)
+
+/* time spent on each channel during evaluation in ms */
+#define XONE_MT_CH_DWELL_TIME 20
+
+/* register pairs per random write command */
+#define XONE_MT_MAX_REG_PAIRS 24
+
+/* number of dongles with cached calibration */
+#define XONE_MT_CAL_CACHE_SIZE 4
 
 /* wireless channel bands */
 #define XONE_MT_CH_2G_LOW 0x01
@@ -49,6 +66,11 @@ enum xone_mt76_wow_traffic {
 	XONE_MT_WOW_TO_HOST = 0x01,
 };
 
+struct xone_mt76_reg {
+	u32 addr;
+	u32 val;
+};
+
 struct xone_mt76_msg_load_cr {
 	u8 mode;
 	u8 temperature;
@@ -67,6 +89,16 @@ struct xone_mt76_msg_switch_channel {
 	u8 unknown;
 } __packed;
 
+/* serializes access to firmware and calibration cache */
+static DEFINE_MUTEX(xone_mt76_cache_lock);
+
+/* all dongles share the same firmware, kept until the module is unloaded */
+static const struct firmware *xone_mt76_fw;
+
+static struct xone_mt76_calibration xone_mt76_cal_cache[XONE_MT_CAL_CACHE_SIZE];
+static int xone_mt76_cal_count;
+static int xone_mt76_cal_next;
+
 static u32 xone_mt76_read_register(struct xone_mt76 *mt, u32 addr)
 {
 	u8 req = MT_VEND_MULTI_READ;
@@ -128,18 +160,23 @@ static int xone_mt76_load_ivb(struct xone_mt76 *mt)
 
 static bool xone_mt76_poll(struct xone_mt76 *mt, u32 offset, u32 mask, u32 val)
 {
-	int i;
+	ktime_t timeout = ktime_add_us(ktime_get(), XONE_MT_POLL_TIMEOUT);
+	unsigned long delay = XONE_MT_POLL_DELAY_MIN;
 	u32 reg;
 
-	for (i = 0; i < XONE_MT_POLL_RETRIES; i++) {
+	for (;;) {
 		reg = xone_mt76_read_register(mt, offset);
 		if ((reg & mask) == val)
 			return true;
 
-		usleep_range(10000, 20000);
-	}
+		if (ktime_after(ktime_get(), timeout))
+			return false;
 
-	return false;
+		/* most operations finish within a few hundred microseconds */
+		usleep_range(delay, delay * 2);
+		delay = min_t(unsigned long, delay * 2,
+			      XONE_MT_POLL_DELAY_MAX);
+	}
 }
 
 static int xone_mt76_read_efuse(struct xone_mt76 *mt, u16 addr,
@@ -205,6 +242,21 @@ void xone_mt76_prep_command(struct sk_buff *skb, enum mt76_mcu_cmd cmd)
 			       FIELD_PREP(MT_MCU_MSG_CMD_TYPE, cmd));
 }
 
+int xone_mt76_prep_command_buffer(u8 *buf, int len, enum mt76_mcu_cmd cmd)
+{
+	int msg_len = round_up(len, sizeof(u32));
+	u32 info = MT_MCU_MSG_TYPE_CMD |
+		   FIELD_PREP(MT_MCU_MSG_PORT, MT_CPU_TX_PORT) |
+		   FIELD_PREP(MT_MCU_MSG_CMD_TYPE, cmd) |
+		   FIELD_PREP(MT_MCU_MSG_LEN, msg_len);
+
+	/* message follows the header, padding and trailer follow it */
+	put_unaligned_le32(info, buf);
+	memset(buf + MT_CMD_HDR_LEN + len, 0, msg_len - len + MT_CMD_HDR_LEN);
+
+	return MT_CMD_HDR_LEN + msg_len + MT_CMD_HDR_LEN;
+}
+
 static int xone_mt76_send_command(struct xone_mt76 *mt, struct sk_buff *skb,
 				  enum mt76_mcu_cmd cmd)
 {
@@ -313,6 +365,45 @@ static int xone_mt76_write_burst(struct xone_mt76 *mt, u32 idx,
 	return xone_mt76_send_command(mt, skb, MT_CMD_BURST_WRITE);
 }
 
+static int xone_mt76_write_registers(struct xone_mt76 *mt,
+				     const struct xone_mt76_reg *regs,
+				     int count)
+{
+	const struct xone_mt76_reg *last = &regs[count - 1];
+	struct sk_buff *skb;
+	int i, len, err;
+
+	/* one command per batch instead of a control transfer per register */
+	while (count) {
+		len = min(count, XONE_MT_MAX_REG_PAIRS);
+
+		skb = xone_mt76_alloc_message(len * sizeof(u32) * 2,
+					      GFP_KERNEL);
+		if (!skb)
+			return -ENOMEM;
+
+		for (i = 0; i < len; i++) {
+			put_unaligned_le32(regs[i].addr + MT_MCU_MEMMAP_WLAN,
+					   skb_put(skb, sizeof(u32)));
+			put_unaligned_le32(regs[i].val,
+					   skb_put(skb, sizeof(u32)));
+		}
+
+		err = xone_mt76_send_command(mt, skb, MT_CMD_RANDOM_WRITE);
+		if (err)
+			return err;
+
+		regs += len;
+		count -= len;
+	}
+
+	/* control transfers bypass the MCU and can overtake the writes */
+	if (!xone_mt76_poll(mt, last->addr, U32_MAX, last->val))
+		return -ETIMEDOUT;
+
+	return 0;
+}
+
 int xone_mt76_set_led_mode(struct xone_mt76 *mt, enum xone_mt76_led_mode mode)
 {
 	struct sk_buff *skb;
@@ -407,21 +498,18 @@ static int xone_mt76_calibrate(struct xone_mt76 *mt,
 	return xone_mt76_send_command(mt, skb, MT_CMD_CALIBRATION_OP);
 }
 
-static int xone_mt76_send_firmware_part(struct xone_mt76 *mt, u32 offset,
-					const u8 *data, u32 len)
+static int xone_mt76_send_firmware_part(struct xone_mt76 *mt, u8 *buf,
+					u32 offset, const u8 *data, u32 len)
 {
-	struct sk_buff *skb;
 	u32 pos, chunk_len, complete;
-	int err;
+	int buf_len, err;
 
 	for (pos = 0; pos < len; pos += XONE_MT_FW_CHUNK_SIZE) {
 		chunk_len = min_t(u32, len - pos, XONE_MT_FW_CHUNK_SIZE);
 
-		skb = xone_mt76_alloc_message(chunk_len, GFP_KERNEL);
-		if (!skb)
-			return -ENOMEM;
-
-		skb_put_data(skb, data + pos, chunk_len);
+		/* buffer is reused for every chunk */
+		memcpy(buf + MT_CMD_HDR_LEN, data + pos, chunk_len);
+		buf_len = xone_mt76_prep_command_buffer(buf, chunk_len, 0);
 		chunk_len = roundup(chunk_len, sizeof(u32));
 
 		xone_mt76_write_register(mt, MT_FCE_DMA_ADDR | MT_VEND_TYPE_CFG,
@@ -429,7 +517,9 @@ static int xone_mt76_send_firmware_part(struct xone_mt76 *mt, u32 offset,
 		xone_mt76_write_register(mt, MT_FCE_DMA_LEN | MT_VEND_TYPE_CFG,
 					 chunk_len << 16);
 
-		err = xone_mt76_send_command(mt, skb, 0);
+		err = usb_bulk_msg(mt->udev,
+				   usb_sndbulkpipe(mt->udev, XONE_MT_EP_OUT),
+				   buf, buf_len, NULL, XONE_MT_USB_TIMEOUT);
 		if (err)
 			return err;
 
@@ -447,6 +537,7 @@ static int xone_mt76_send_firmware(struct xone_mt76 *mt,
 {
 	const struct mt76_fw_header *hdr;
 	u32 ilm_len, dlm_len;
+	u8 *buf;
 	int err;
 
 	if (fw->size < sizeof(*hdr))
@@ -472,16 +563,25 @@ static int xone_mt76_send_firmware(struct xone_mt76 *mt,
 	xone_mt76_write_register(mt, MT_FCE_PDMA_GLOBAL_CONF, 0x44);
 	xone_mt76_write_register(mt, MT_FCE_SKIP_FS, 0x03);
 
+	buf = kmalloc(XONE_MT_FW_BUF_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
 	/* send instruction local memory */
-	err = xone_mt76_send_firmware_part(mt, XONE_MT_FW_ILM_OFFSET,
+	err = xone_mt76_send_firmware_part(mt, buf, XONE_MT_FW_ILM_OFFSET,
 					   fw->data + sizeof(*hdr), ilm_len);
 	if (err)
-		return err;
+		goto err_free_buf;
 
 	/* send data local memory */
-	return xone_mt76_send_firmware_part(mt, XONE_MT_FW_DLM_OFFSET,
-					    fw->data + sizeof(*hdr) + ilm_len,
-					    dlm_len);
+	err = xone_mt76_send_firmware_part(mt, buf, XONE_MT_FW_DLM_OFFSET,
+					   fw->data + sizeof(*hdr) + ilm_len,
+					   dlm_len);
+
+err_free_buf:
+	kfree(buf);
+
+	return err;
 }
 
 static int xone_mt76_reset_firmware(struct xone_mt76 *mt)
@@ -506,41 +606,73 @@ static int xone_mt76_reset_firmware(struct xone_mt76 *mt)
 	return 0;
 }
 
-int xone_mt76_load_firmware(struct xone_mt76 *mt, const char *name)
+static const struct firmware *xone_mt76_get_firmware(struct xone_mt76 *mt,
+						     const char *name)
 {
 	const struct firmware *fw;
-	int err;
+	int err = 0;
 
-	if (xone_mt76_read_register(mt, MT_FCE_DMA_ADDR | MT_VEND_TYPE_CFG)) {
-		dev_dbg(mt->dev, "%s: resetting firmware...\n", __func__);
-		return xone_mt76_reset_firmware(mt);
-	}
+	mutex_lock(&xone_mt76_cache_lock);
 
-	err = request_firmware(&fw, name, mt->dev);
-	if (err) {
+	/* skip the filesystem when probing further dongles */
+	if (!xone_mt76_fw) {
+		err = request_firmware(&xone_mt76_fw, name, mt->dev);
 		if (err == -ENOENT)
 			dev_err(mt->dev, "%s: firmware not found\n", __func__);
+	}
+
+	fw = xone_mt76_fw ?: ERR_PTR(err);
+	mutex_unlock(&xone_mt76_cache_lock);
+
+	return fw;
+}
+
+void xone_mt76_free_firmware(void)
+{
+	mutex_lock(&xone_mt76_cache_lock);
+	release_firmware(xone_mt76_fw);
+	xone_mt76_fw = NULL;
+	mutex_unlock(&xone_mt76_cache_lock);
+}
+
+int xone_mt76_load_firmware(struct xone_mt76 *mt, const char *name)
+{
+	const struct firmware *fw;
+	ktime_t start = ktime_get();
+	ktime_t sent;
+	int err;
 
+	if (xone_mt76_read_register(mt, MT_FCE_DMA_ADDR | MT_VEND_TYPE_CFG)) {
+		dev_dbg(mt->dev, "%s: resetting firmware...\n", __func__);
+		err = xone_mt76_reset_firmware(mt);
+		dev_dbg(mt->dev, "%s: reset=%lldus\n", __func__,
+			ktime_us_delta(ktime_get(), start));
 		return err;
 	}
 
+	fw = xone_mt76_get_firmware(mt, name);
+	if (IS_ERR(fw))
+		return PTR_ERR(fw);
+
 	err = xone_mt76_send_firmware(mt, fw);
 	if (err)
-		goto err_free_firmware;
+		return err;
+
+	sent = ktime_get();
 
 	xone_mt76_write_register(mt, MT_FCE_DMA_ADDR | MT_VEND_TYPE_CFG, 0);
 
 	err = xone_mt76_load_ivb(mt);
 	if (err)
-		goto err_free_firmware;
+		return err;
 
 	if (!xone_mt76_poll(mt, MT_FCE_DMA_ADDR | MT_VEND_TYPE_CFG, 0x01, 0x01))
-		err = -ETIMEDOUT;
+		return -ETIMEDOUT;
 
-err_free_firmware:
-	release_firmware(fw);
+	dev_dbg(mt->dev, "%s: upload=%lldus, boot=%lldus\n", __func__,
+		ktime_us_delta(sent, start), ktime_us_delta(ktime_get(), sent));
 
-	return err;
+	return 0;
 }
 
 static const struct xone_mt76_channel
@@ -559,12 +691,23 @@ xone_mt76_channels[XONE_MT_NUM_CHANNELS] = {
 	{ 0xa5, XONE_MT_CH_5G_HIGH, MT_PHY_BW_80, MT_CH_5G_UNII_3, false },
 };
 
+static int xone_mt76_compare_channels(const void *a, const void *b)
+{
+	const struct xone_mt76_channel *chan_a =
+		*(struct xone_mt76_channel * const *)a;
+	const struct xone_mt76_channel *chan_b =
+		*(struct xone_mt76_channel * const *)b;
+
+	return xone_mt76_get_channel_load(chan_a) -
+	       xone_mt76_get_channel_load(chan_b);
+}
+
 static int xone_mt76_set_channel_candidates(struct xone_mt76 *mt)
 {
+	struct xone_mt76_channel *chans[XONE_MT_NUM_CHANNELS - 1];
 	struct sk_buff *skb;
 	u8 best_chan = mt->channel->index;
-	u8 chan;
-	int i, err;
+	int i, count = 0, err;
 
 	skb = alloc_skb(sizeof(u32) * 2 + sizeof(u32) * XONE_MT_NUM_CHANNELS,
 			GFP_KERNEL);
@@ -575,11 +718,15 @@ static int xone_mt76_set_channel_candidates(struct xone_mt76 *mt)
 	put_unaligned_le32(best_chan, skb_put(skb, sizeof(u32)));
 	put_unaligned_le32(XONE_MT_NUM_CHANNELS - 1, skb_put(skb, sizeof(u32)));
 
-	for (i = 0; i < XONE_MT_NUM_CHANNELS; i++) {
-		chan = mt->channels[i].index;
-		if (chan != best_chan)
-			put_unaligned_le32(chan, skb_put(skb, sizeof(u32)));
-	}
+	for (i = 0; i < XONE_MT_NUM_CHANNELS; i++)
+		if (mt->channels[i].index != best_chan)
+			chans[count++] = &mt->channels[i];
+
+	/* fallback channels from least to most busy */
+	sort(chans, count, sizeof(*chans), xone_mt76_compare_channels, NULL);
+
+	for (i = 0; i < count; i++)
+		put_unaligned_le32(chans[i]->index, skb_put(skb, sizeof(u32)));
 
 	err = xone_mt76_send_ms_command(mt, XONE_MT_SET_CHAN_CANDIDATES,
 					skb->data, skb->len);
@@ -626,6 +773,136 @@ static int xone_mt76_get_channel_power(struct xone_mt76 *mt,
 	return 0;
 }
 
+void xone_mt76_survey_channel(struct xone_mt76 *mt,
+			      struct xone_mt76_channel *chan)
+{
+	/* counters are cleared on read */
+	u32 idle = xone_mt76_read_register(mt, MT_CH_IDLE);
+	u32 busy = xone_mt76_read_register(mt, MT_CH_BUSY);
+	u32 energy = xone_mt76_read_register(mt, MT_ED_CCA_TIMER);
+	u32 stat = xone_mt76_read_register(mt, MT_RX_STAT_1);
+	u32 failed = FIELD_GET(MT_TX_STA_0_FAILURES,
+			       xone_mt76_read_register(mt, MT_TX_STA_0));
+	u32 acked = FIELD_GET(MT_TX_STA_1_SUCCESSES,
+			      xone_mt76_read_register(mt, MT_TX_STA_1));
+	u64 total = (u64)idle + busy;
+
+	if (!total)
+		return;
+
+	/* energy detection also covers non-WLAN interference */
+	chan->busy = div64_u64((u64)busy * 1000, total);
+	chan->energy = min_t(u64, div64_u64((u64)energy * 1000, total), 1000);
+	chan->cca_errors = FIELD_GET(MT_RX_STAT_1_CCA_ERRORS, stat);
+	chan->tx_failures = failed + acked ?
+			    failed * 1000 / (failed + acked) : 0;
+	chan->surveyed = ktime_get();
+}
+
+int xone_mt76_get_channel_load(const struct xone_mt76_channel *chan)
+{
+	return chan->busy + chan->energy;
+}
+
+int xone_mt76_survey_candidate(struct xone_mt76 *mt,
+			       struct xone_mt76_channel *chan)
+{
+	int err;
+
+	/* clients miss the beacons while the radio is away */
+	err = xone_mt76_switch_channel(mt, chan);
+	if (err)
+		return err;
+
+	xone_mt76_survey_channel(mt, chan);
+	msleep(XONE_MT_CH_DWELL_TIME);
+	xone_mt76_survey_channel(mt, chan);
+
+	dev_dbg(mt->dev, "%s: channel=%u, busy=%u, energy=%u\n", __func__,
+		chan->index, chan->busy, chan->energy);
+
+	return xone_mt76_switch_channel(mt, mt->channel);
+}
+
+static int xone_mt76_get_channel_frequency(const struct xone_mt76_channel *chan)
+{
+	return chan->index * 5 + (chan->index <= 14 ? 2407 : 5000);
+}
+
+static bool xone_mt76_channels_overlap(const struct xone_mt76_channel *a,
+				       const struct xone_mt76_channel *b)
+{
+	int dist = abs(xone_mt76_get_channel_frequency(a) -
+		       xone_mt76_get_channel_frequency(b));
+
+	/* bandwidth in MHz around the primary channel */
+	return dist < ((20 << a->bandwidth) + (20 << b->bandwidth)) / 2;
+}
+
+void xone_mt76_avoid_channel(struct xone_mt76 *mt,
+			     const struct xone_mt76_channel *chan)
+{
+	int i;
+
+	for (i = 0; i < XONE_MT_NUM_CHANNELS; i++)
+		if (xone_mt76_channels_overlap(&xone_mt76_channels[i], chan))
+			mt->channels_used |= BIT(i);
+}
+
+bool xone_mt76_channel_used(struct xone_mt76 *mt,
+			    struct xone_mt76_channel *chan)
+{
+	return mt->channels_used & BIT(chan - mt->channels);
+}
+
+static struct xone_mt76_channel *
+xone_mt76_pick_channel(struct xone_mt76 *mt, struct xone_mt76_channel *skip)
+{
+	struct xone_mt76_channel *chan, *best = NULL;
+	int i;
+
+	for (i = 0; i < XONE_MT_NUM_CHANNELS; i++) {
+		chan = &mt->channels[i];
+		if (chan == skip || xone_mt76_channel_used(mt, chan))
+			continue;
+
+		/* prefer later channels on ties like the original driver */
+		if (!best || xone_mt76_get_channel_load(chan) <=
+			     xone_mt76_get_channel_load(best))
+			best = chan;
+	}
+
+	return best;
+}
+
+struct xone_mt76_channel *xone_mt76_find_channel(struct xone_mt76 *mt)
+{
+	return xone_mt76_pick_channel(mt, mt->channel);
+}
+
+void xone_mt76_select_channel(struct xone_mt76 *mt)
+{
+	struct xone_mt76_channel *chan;
+
+	/* keep the channel of a dongle probed before */
+	if (mt->calibrated &&
+	    !xone_mt76_channel_used(mt, &mt->channels[mt->cal.channel])) {
+		mt->channel = &mt->channels[mt->cal.channel];
+		return;
+	}
+
+	chan = xone_mt76_pick_channel(mt, NULL);
+
+	/* all channels are used by other dongles */
+	if (!chan) {
+		mt->channels_used = 0;
+		chan = xone_mt76_pick_channel(mt, NULL);
+	}
+
+	mt->channel = chan;
+	mt->cal.channel = chan - mt->channels;
+}
+
 static int xone_mt76_evaluate_channels(struct xone_mt76 *mt)
 {
 	struct xone_mt76_channel *chan;
@@ -633,6 +910,18 @@ static int xone_mt76_evaluate_channels(struct xone_mt76 *mt)
 
 	memcpy(mt->channels, xone_mt76_channels, sizeof(xone_mt76_channels));
 
+	/* skip the channel sweep if the dongle has been probed before */
+	if (mt->calibrated) {
+		/* cached activity only orders the candidates */
+		for (i = 0; i < XONE_MT_NUM_CHANNELS; i++) {
+			mt->channels[i].power = mt->cal.power[i];
+			mt->channels[i].busy = mt->cal.busy[i];
+			mt->channels[i].energy = mt->cal.energy[i];
+		}
+
+		return 0;
+	}
+
 	for (i = 0; i < XONE_MT_NUM_CHANNELS; i++) {
 		chan = &mt->channels[i];
 
@@ -645,13 +934,22 @@ static int xone_mt76_evaluate_channels(struct xone_mt76 *mt)
 		if (err)
 			return err;
 
+		mt->cal.power[i] = chan->power;
+
+		/* first survey clears the counters of the previous channel */
+		xone_mt76_survey_channel(mt, chan);
+		msleep(XONE_MT_CH_DWELL_TIME);
+		xone_mt76_survey_channel(mt, chan);
+
+		mt->cal.busy[i] = chan->busy;
+		mt->cal.energy[i] = chan->energy;
+
 		dev_dbg(mt->dev, "%s: channel=%u, power=%u\n", __func__,
 			chan->index, chan->power);
+		dev_dbg(mt->dev, "%s: busy=%u, energy=%u, cca_errors=%u\n",
+			__func__, chan->busy, chan->energy, chan->cca_errors);
 	}
 
-	/* the last channel might not be the best one */
-	mt->channel = chan;
-
 	return 0;
 }
 
@@ -669,6 +967,13 @@ static int xone_mt76_init_channels(struct xone_mt76 *mt)
 	/* disable promiscuous mode */
 	xone_mt76_write_register(mt, MT_RX_FILTR_CFG, 0x017f17);
 
+	return 0;
+}
+
+static int xone_mt76_start_channel(struct xone_mt76 *mt)
+{
+	int err;
+
 	dev_dbg(mt->dev, "%s: channel=%u\n", __func__, mt->channel->index);
 
 	mt->channel->scan = true;
@@ -709,10 +1014,8 @@ static int xone_mt76_init_address(struct xone_mt76 *mt)
 {
 	int err;
 
-	err = xone_mt76_read_efuse(mt, MT_EE_MAC_ADDR,
-				   mt->address, sizeof(mt->address));
-	if (err)
-		return err;
+	/* read by xone_mt76_load_calibration */
+	memcpy(mt->address, mt->cal.address, sizeof(mt->address));
 
 	dev_dbg(mt->dev, "%s: address=%pM\n", __func__, mt->address);
 
@@ -738,12 +1041,11 @@ static int xone_mt76_init_address(struct xone_mt76 *mt)
 					 mt->address, sizeof(mt->address));
 }
 
-static int xone_mt76_calibrate_crystal(struct xone_mt76 *mt)
+static int xone_mt76_read_crystal_trim(struct xone_mt76 *mt, u16 *trim_val)
 {
 	u8 trim[4];
 	u16 val;
 	s8 offset;
-	u32 ctrl;
 	int err;
 
 	err = xone_mt76_read_efuse(mt, MT_EE_XTAL_TRIM_2, trim, sizeof(trim));
@@ -770,10 +1072,121 @@ static int xone_mt76_calibrate_crystal(struct xone_mt76 *mt)
 			val = 0x14;
 	}
 
-	val = (val & GENMASK(6, 0)) + offset;
+	*trim_val = (val & GENMASK(6, 0)) + offset;
+
+	return 0;
+}
+
+/* gains are stored as magnitude and sign, positive if the bit is set */
+static s8 xone_mt76_sign_extend(u32 val, int size)
+{
+	bool sign = val & BIT(size - 1);
+
+	val &= BIT(size - 1) - 1;
+
+	return sign ? val : -val;
+}
+
+static bool xone_mt76_field_valid(u8 val)
+{
+	return val && val != 0xff;
+}
+
+static int xone_mt76_init_rx_gain(struct xone_mt76 *mt)
+{
+	const struct xone_mt76_channel *chan;
+	u8 gain[12], conf[4];
+	u8 lna_2g, lna_5g[3], lna, val;
+	s8 offset_2g = 0, offset_5g = 0, offset;
+	u16 nic_conf;
+	int i, err;
+
+	if (mt->calibrated)
+		return 0;
+
+	/* LNA gains and RSSI offsets from 0x44 to 0x4f */
+	err = xone_mt76_read_efuse(mt, MT_EE_LNA_GAIN, gain, sizeof(gain));
+	if (err)
+		return err;
+
+	err = xone_mt76_read_efuse(mt, MT_EE_NIC_CONF_1, conf, sizeof(conf));
+	if (err)
+		return err;
+
+	/* same defaults as mt76x02_get_rx_gain */
+	lna_2g = gain[0];
+	lna_5g[0] = gain[1];
+	lna_5g[1] = gain[MT_EE_LNA_GAIN_5GHZ_1 - MT_EE_LNA_GAIN];
+	lna_5g[2] = gain[MT_EE_LNA_GAIN_5GHZ_2 - MT_EE_LNA_GAIN];
+
+	if (!xone_mt76_field_valid(lna_5g[1]))
+		lna_5g[1] = lna_5g[0];
+
+	if (!xone_mt76_field_valid(lna_5g[2]))
+		lna_5g[2] = lna_5g[0];
+
+	/* external LNAs are not corrected for */
+	nic_conf = (conf[3] << 8) | conf[2];
+	if (nic_conf & MT_EE_NIC_CONF_1_LNA_EXT_2G)
+		lna_2g = 0;
+
+	if (nic_conf & MT_EE_NIC_CONF_1_LNA_EXT_5G)
+		memset(lna_5g, 0, sizeof(lna_5g));
+
+	/* offsets are only applied if enabled by bit 7 */
+	val = gain[MT_EE_RSSI_OFFSET_2G_0 - MT_EE_LNA_GAIN];
+	if (xone_mt76_field_valid(val) && (val & BIT(7)))
+		offset_2g = xone_mt76_sign_extend(val, 7);
+
+	val = gain[MT_EE_RSSI_OFFSET_5G_0 - MT_EE_LNA_GAIN];
+	if (xone_mt76_field_valid(val) && (val & BIT(7)))
+		offset_5g = xone_mt76_sign_extend(val, 7);
+
+	for (i = 0; i < XONE_MT_NUM_CHANNELS; i++) {
+		chan = &xone_mt76_channels[i];
+		offset = chan->index <= 14 ? offset_2g : offset_5g;
+
+		if (chan->index <= 14)
+			lna = lna_2g;
+		else if (chan->index <= 64)
+			lna = lna_5g[0];
+		else if (chan->index <= 128)
+			lna = lna_5g[1];
+		else
+			lna = lna_5g[2];
+
+		if (lna == 0xff)
+			lna = 0;
+
+		mt->cal.rssi_offset[i] = offset - xone_mt76_sign_extend(lna, 8);
+	}
+
+	return 0;
+}
+
+int xone_mt76_get_rssi(struct xone_mt76 *mt, s8 rssi)
+{
+	struct xone_mt76_channel *chan = READ_ONCE(mt->channel);
+
+	/* RSSI in dBm, like mt76x02_mac_get_rssi */
+	return rssi + mt->cal.rssi_offset[chan - mt->channels];
+}
+
+static int xone_mt76_calibrate_crystal(struct xone_mt76 *mt)
+{
+	u32 ctrl;
+	int err;
+
+	if (!mt->calibrated) {
+		err = xone_mt76_read_crystal_trim(mt, &mt->cal.crystal);
+		if (err)
+			return err;
+	}
+
 	ctrl = xone_mt76_read_register(mt, MT_XO_CTRL5 | MT_VEND_TYPE_CFG);
 	xone_mt76_write_register(mt, MT_XO_CTRL5 | MT_VEND_TYPE_CFG,
-				 (ctrl & ~MT_XO_CTRL5_C2_VAL) | (val << 8));
+				 (ctrl & ~MT_XO_CTRL5_C2_VAL) |
+				 (mt->cal.crystal << 8));
 	xone_mt76_write_register(mt, MT_XO_CTRL6 | MT_VEND_TYPE_CFG,
 				 MT_XO_CTRL6_C2_CTRL);
 	xone_mt76_write_register(mt, MT_CMB_CTRL, 0x0091a7ff);
@@ -783,16 +1196,20 @@ static int xone_mt76_calibrate_crystal(struct xone_mt76 *mt)
 
 static int xone_mt76_calibrate_radio(struct xone_mt76 *mt)
 {
+	static const struct xone_mt76_reg regs[] = {
+		/* configure automatic gain control (AGC) */
+		{ MT_BBP(AGC, 8), 0x18365efa },
+		{ MT_BBP(AGC, 9), 0x18365efa },
+		/* reset required for reliable WLAN associations */
+		{ MT_MAC_SYS_CTRL, 0 },
+		{ MT_RF_BYPASS_0, 0 },
+		{ MT_RF_SETTING_0, 0 },
+	};
 	int err;
 
-	/* configure automatic gain control (AGC) */
-	xone_mt76_write_register(mt, MT_BBP(AGC, 8), 0x18365efa);
-	xone_mt76_write_register(mt, MT_BBP(AGC, 9), 0x18365efa);
-
-	/* reset required for reliable WLAN associations */
-	xone_mt76_write_register(mt, MT_MAC_SYS_CTRL, 0);
-	xone_mt76_write_register(mt, MT_RF_BYPASS_0, 0);
-	xone_mt76_write_register(mt, MT_RF_SETTING_0, 0);
+	err = xone_mt76_write_registers(mt, regs, ARRAY_SIZE(regs));
+	if (err)
+		return err;
 
 	err = xone_mt76_calibrate(mt, MT_MCU_CAL_TEMP_SENSOR, 0);
 	if (err)
@@ -813,77 +1230,155 @@ static int xone_mt76_calibrate_radio(struct xone_mt76 *mt)
 	return 0;
 }
 
-static void xone_mt76_init_registers(struct xone_mt76 *mt)
+static int xone_mt76_load_calibration(struct xone_mt76 *mt)
+{
+	struct xone_mt76_calibration *cal;
+	int i, err;
+
+	/* the factory address identifies the dongle */
+	err = xone_mt76_read_efuse(mt, MT_EE_MAC_ADDR, mt->cal.address,
+				   sizeof(mt->cal.address));
+	if (err)
+		return err;
+
+	mt->calibrated = false;
+	mutex_lock(&xone_mt76_cache_lock);
+
+	for (i = 0; i < xone_mt76_cal_count; i++) {
+		cal = &xone_mt76_cal_cache[i];
+		if (ether_addr_equal(cal->address, mt->cal.address)) {
+			mt->cal = *cal;
+			mt->calibrated = true;
+			break;
+		}
+	}
+
+	mutex_unlock(&xone_mt76_cache_lock);
+
+	dev_dbg(mt->dev, "%s: cached=%d\n", __func__, mt->calibrated);
+
+	return 0;
+}
+
+static void xone_mt76_store_calibration(struct xone_mt76 *mt)
+{
+	int i;
+
+	mutex_lock(&xone_mt76_cache_lock);
+
+	for (i = 0; i < xone_mt76_cal_count; i++)
+		if (ether_addr_equal(xone_mt76_cal_cache[i].address,
+				     mt->cal.address))
+			break;
+
+	/* replace the oldest entry if the cache is full */
+	if (i == xone_mt76_cal_count) {
+		i = xone_mt76_cal_next;
+		xone_mt76_cal_next = (i + 1) % XONE_MT_CAL_CACHE_SIZE;
+		xone_mt76_cal_count = min(xone_mt76_cal_count + 1,
+					  XONE_MT_CAL_CACHE_SIZE);
+	}
+
+	xone_mt76_cal_cache[i] = mt->cal;
+	mutex_unlock(&xone_mt76_cache_lock);
+}
+
+/*
+ * Tables end with a register that reads back as written.
+ * It is polled to make sure the MCU has applied the whole table.
+ */
+
+/* power and DMA defaults, written after the reset */
+static const struct xone_mt76_reg xone_mt76_init_regs[] = {
+	{ MT_PWR_PIN_CFG, 0 },
+	{ MT_LDO_CTRL_1, 0x6b006464 },
+	{ MT_WPDMA_GLO_CFG, 0x70 },
+	{ MT_WMM_AIFSN, 0x2273 },
+	{ MT_WMM_CWMIN, 0x2344 },
+	{ MT_WMM_CWMAX, 0x34aa },
+};
+
+/* MAC, EDCA, protection and RF defaults */
+static const struct xone_mt76_reg xone_mt76_init_regs_mac[] = {
+	{ MT_TSO_CTRL, 0 },
+	{ MT_PBF_SYS_CTRL, 0x080c00 },
+	{ MT_PBF_TX_MAX_PCNT, 0x1fbf1f1f },
+	{ MT_FCE_PSE_CTRL, 0x01 },
+	{ MT_MAC_SYS_CTRL,
+	  MT_MAC_SYS_CTRL_ENABLE_RX | MT_MAC_SYS_CTRL_ENABLE_TX },
+	{ MT_AUTO_RSP_CFG, 0x13 },
+	{ MT_MAX_LEN_CFG, 0x3e3fff },
+	{ MT_AMPDU_MAX_LEN_20M1S, 0xfffc9855 },
+	{ MT_AMPDU_MAX_LEN_20M2S, 0xff },
+	{ MT_BKOFF_SLOT_CFG, 0x0109 },
+	{ MT_PWR_PIN_CFG, 0 },
+	{ MT_EDCA_CFG_AC(0), 0x064320 },
+	{ MT_EDCA_CFG_AC(1), 0x0a4700 },
+	{ MT_EDCA_CFG_AC(2), 0x043238 },
+	{ MT_EDCA_CFG_AC(3), 0x03212f },
+	{ MT_TX_PIN_CFG, 0x150f0f },
+	{ MT_TX_SW_CFG0, 0x101001 },
+	{ MT_TX_SW_CFG1, 0x010000 },
+	{ MT_TXOP_CTRL_CFG, 0x10583f },
+	{ MT_TX_TIMEOUT_CFG, 0x0a0f90 },
+	{ MT_TX_RETRY_CFG, 0x47d01f0f },
+	{ MT_CCK_PROT_CFG, 0x03f40003 },
+	{ MT_OFDM_PROT_CFG, 0x03f40003 },
+	{ MT_MM20_PROT_CFG, 0x01742004 },
+	{ MT_GF20_PROT_CFG, 0x01742004 },
+	{ MT_GF40_PROT_CFG, 0x03f42084 },
+	{ MT_EXP_ACK_TIME, 0x2c00dc },
+	{ MT_TX_ALC_CFG_2, 0x22160a00 },
+	{ MT_TX_ALC_CFG_3, 0x22160a76 },
+	{ MT_TX_ALC_CFG_0, 0x3f3f1818 },
+	{ MT_TX_ALC_CFG_4, 0x0606 },
+	{ MT_PIFS_TX_CFG, 0x060fff },
+	{ MT_RX_FILTR_CFG, 0x017f17 },
+	{ MT_LEGACY_BASIC_RATE, 0x017f },
+	{ MT_HT_BASIC_RATE, 0x8003 },
+	{ MT_PN_PAD_MODE, 0x02 },
+	{ MT_TXOP_HLDR_ET, 0x02 },
+	{ MT_TX_PROT_CFG6, 0xe3f42004 },
+	{ MT_TX_PROT_CFG7, 0xe3f42084 },
+	{ MT_TX_PROT_CFG8, 0xe3f42104 },
+	{ MT_DACCLK_EN_DLY_CFG, 0 },
+	{ MT_RF_PA_MODE_ADJ0, 0xee000000 },
+	{ MT_RF_PA_MODE_ADJ1, 0xee000000 },
+	{ MT_TX0_RF_GAIN_CORR, 0x0f3c3c3c },
+	{ MT_TX1_RF_GAIN_CORR, 0x0f3c3c3c },
+	{ MT_PBF_CFG, 0x1efebcf5 },
+	{ MT_PAUSE_ENABLE_CONTROL1, 0x0a },
+	{ MT_RF_BYPASS_0, 0x7f000000 },
+	{ MT_RF_SETTING_0, 0x1a800000 },
+	{ MT_XIFS_TIME_CFG, 0x33a40e0a },
+	{ MT_FCE_L2_STUFF, 0x03ff0223 },
+	{ MT_TX_RTS_CFG, 0 },
+	{ MT_BEACON_TIME_CFG, 0x0640 },
+	{ MT_EXT_CCA_CFG, 0xf0e4 },
+	{ MT_CH_TIME_CFG, 0x015f },
+};
+
+static int xone_mt76_init_registers(struct xone_mt76 *mt)
 {
+	int err;
+
+	/* reset MAC and DMA before switching to MCU writes */
 	xone_mt76_write_register(mt, MT_MAC_SYS_CTRL,
 				 MT_MAC_SYS_CTRL_RESET_BBP |
 				 MT_MAC_SYS_CTRL_RESET_CSR);
 	xone_mt76_write_register(mt, MT_USB_DMA_CFG, 0);
 	xone_mt76_write_register(mt, MT_MAC_SYS_CTRL, 0);
-	xone_mt76_write_register(mt, MT_PWR_PIN_CFG, 0);
-	xone_mt76_write_register(mt, MT_LDO_CTRL_1, 0x6b006464);
-	xone_mt76_write_register(mt, MT_WPDMA_GLO_CFG, 0x70);
-	xone_mt76_write_register(mt, MT_WMM_AIFSN, 0x2273);
-	xone_mt76_write_register(mt, MT_WMM_CWMIN, 0x2344);
-	xone_mt76_write_register(mt, MT_WMM_CWMAX, 0x34aa);
+
+	err = xone_mt76_write_registers(mt, xone_mt76_init_regs,
+					ARRAY_SIZE(xone_mt76_init_regs));
+	if (err)
+		return err;
+
+	/* DMA address is written directly, as during firmware upload */
 	xone_mt76_write_register(mt, MT_FCE_DMA_ADDR, 0x041200);
-	xone_mt76_write_register(mt, MT_TSO_CTRL, 0);
-	xone_mt76_write_register(mt, MT_PBF_SYS_CTRL, 0x080c00);
-	xone_mt76_write_register(mt, MT_PBF_TX_MAX_PCNT, 0x1fbf1f1f);
-	xone_mt76_write_register(mt, MT_FCE_PSE_CTRL, 0x01);
-	xone_mt76_write_register(mt, MT_MAC_SYS_CTRL,
-				 MT_MAC_SYS_CTRL_ENABLE_RX |
-				 MT_MAC_SYS_CTRL_ENABLE_TX);
-	xone_mt76_write_register(mt, MT_AUTO_RSP_CFG, 0x13);
-	xone_mt76_write_register(mt, MT_MAX_LEN_CFG, 0x3e3fff);
-	xone_mt76_write_register(mt, MT_AMPDU_MAX_LEN_20M1S, 0xfffc9855);
-	xone_mt76_write_register(mt, MT_AMPDU_MAX_LEN_20M2S, 0xff);
-	xone_mt76_write_register(mt, MT_BKOFF_SLOT_CFG, 0x0109);
-	xone_mt76_write_register(mt, MT_PWR_PIN_CFG, 0);
-	xone_mt76_write_register(mt, MT_EDCA_CFG_AC(0), 0x064320);
-	xone_mt76_write_register(mt, MT_EDCA_CFG_AC(1), 0x0a4700);
-	xone_mt76_write_register(mt, MT_EDCA_CFG_AC(2), 0x043238);
-	xone_mt76_write_register(mt, MT_EDCA_CFG_AC(3), 0x03212f);
-	xone_mt76_write_register(mt, MT_TX_PIN_CFG, 0x150f0f);
-	xone_mt76_write_register(mt, MT_TX_SW_CFG0, 0x101001);
-	xone_mt76_write_register(mt, MT_TX_SW_CFG1, 0x010000);
-	xone_mt76_write_register(mt, MT_TXOP_CTRL_CFG, 0x10583f);
-	xone_mt76_write_register(mt, MT_TX_TIMEOUT_CFG, 0x0a0f90);
-	xone_mt76_write_register(mt, MT_TX_RETRY_CFG, 0x47d01f0f);
-	xone_mt76_write_register(mt, MT_CCK_PROT_CFG, 0x03f40003);
-	xone_mt76_write_register(mt, MT_OFDM_PROT_CFG, 0x03f40003);
-	xone_mt76_write_register(mt, MT_MM20_PROT_CFG, 0x01742004);
-	xone_mt76_write_register(mt, MT_GF20_PROT_CFG, 0x01742004);
-	xone_mt76_write_register(mt, MT_GF40_PROT_CFG, 0x03f42084);
-	xone_mt76_write_register(mt, MT_EXP_ACK_TIME, 0x2c00dc);
-	xone_mt76_write_register(mt, MT_TX_ALC_CFG_2, 0x22160a00);
-	xone_mt76_write_register(mt, MT_TX_ALC_CFG_3, 0x22160a76);
-	xone_mt76_write_register(mt, MT_TX_ALC_CFG_0, 0x3f3f1818);
-	xone_mt76_write_register(mt, MT_TX_ALC_CFG_4, 0x0606);
-	xone_mt76_write_register(mt, MT_PIFS_TX_CFG, 0x060fff);
-	xone_mt76_write_register(mt, MT_RX_FILTR_CFG, 0x017f17);
-	xone_mt76_write_register(mt, MT_LEGACY_BASIC_RATE, 0x017f);
-	xone_mt76_write_register(mt, MT_HT_BASIC_RATE, 0x8003);
-	xone_mt76_write_register(mt, MT_PN_PAD_MODE, 0x02);
-	xone_mt76_write_register(mt, MT_TXOP_HLDR_ET, 0x02);
-	xone_mt76_write_register(mt, MT_TX_PROT_CFG6, 0xe3f42004);
-	xone_mt76_write_register(mt, MT_TX_PROT_CFG7, 0xe3f42084);
-	xone_mt76_write_register(mt, MT_TX_PROT_CFG8, 0xe3f42104);
-	xone_mt76_write_register(mt, MT_DACCLK_EN_DLY_CFG, 0);
-	xone_mt76_write_register(mt, MT_RF_PA_MODE_ADJ0, 0xee000000);
-	xone_mt76_write_register(mt, MT_RF_PA_MODE_ADJ1, 0xee000000);
-	xone_mt76_write_register(mt, MT_TX0_RF_GAIN_CORR, 0x0f3c3c3c);
-	xone_mt76_write_register(mt, MT_TX1_RF_GAIN_CORR, 0x0f3c3c3c);
-	xone_mt76_write_register(mt, MT_PBF_CFG, 0x1efebcf5);
-	xone_mt76_write_register(mt, MT_PAUSE_ENABLE_CONTROL1, 0x0a);
-	xone_mt76_write_register(mt, MT_RF_BYPASS_0, 0x7f000000);
-	xone_mt76_write_register(mt, MT_RF_SETTING_0, 0x1a800000);
-	xone_mt76_write_register(mt, MT_XIFS_TIME_CFG, 0x33a40e0a);
-	xone_mt76_write_register(mt, MT_FCE_L2_STUFF, 0x03ff0223);
-	xone_mt76_write_register(mt, MT_TX_RTS_CFG, 0);
-	xone_mt76_write_register(mt, MT_BEACON_TIME_CFG, 0x0640);
-	xone_mt76_write_register(mt, MT_EXT_CCA_CFG, 0xf0e4);
-	xone_mt76_write_register(mt, MT_CH_TIME_CFG, 0x015f);
+
+	return xone_mt76_write_registers(mt, xone_mt76_init_regs_mac,
+					 ARRAY_SIZE(xone_mt76_init_regs_mac));
 }
 
 static u16 xone_mt76_get_chip_id(struct xone_mt76 *mt)
@@ -896,6 +1391,29 @@ static u16 xone_mt76_get_chip_id(struct xone_mt76 *mt)
 	return (id[1] << 8) | id[2];
 }
 
+static void xone_mt76_init_usb_dma(struct xone_mt76 *mt)
+{
+	u32 val;
+
+	val = xone_mt76_read_register(mt, MT_USB_U3DMA_CFG | MT_VEND_TYPE_CFG);
+	val &= ~(MT_USB_DMA_CFG_RX_BULK_AGG_EN |
+		 MT_USB_DMA_CFG_RX_BULK_AGG_TOUT |
+		 MT_USB_DMA_CFG_RX_BULK_AGG_LMT);
+
+	/* pack multiple messages into a single bulk IN transfer */
+	if (mt->rx_agg_limit)
+		val |= MT_USB_DMA_CFG_RX_BULK_AGG_EN |
+		       FIELD_PREP(MT_USB_DMA_CFG_RX_BULK_AGG_TOUT,
+				  XONE_MT_RX_AGG_TIMEOUT) |
+		       FIELD_PREP(MT_USB_DMA_CFG_RX_BULK_AGG_LMT,
+				  mt->rx_agg_limit);
+
+	xone_mt76_write_register(mt, MT_USB_U3DMA_CFG | MT_VEND_TYPE_CFG, val);
+
+	dev_dbg(mt->dev, "%s: aggregation limit=%u KiB\n", __func__,
+		mt->rx_agg_limit);
+}
+
 int xone_mt76_init_radio(struct xone_mt76 *mt)
 {
 	int err;
@@ -903,6 +1421,10 @@ int xone_mt76_init_radio(struct xone_mt76 *mt)
 	dev_dbg(mt->dev, "%s: id=0x%04x\n", __func__,
 		xone_mt76_get_chip_id(mt));
 
+	err = xone_mt76_load_calibration(mt);
+	if (err)
+		return err;
+
 	err = xone_mt76_select_function(mt, MT_Q_SELECT, 1);
 	if (err)
 		return err;
@@ -915,7 +1437,11 @@ int xone_mt76_init_radio(struct xone_mt76 *mt)
 	if (err)
 		return err;
 
-	xone_mt76_init_registers(mt);
+	err = xone_mt76_init_registers(mt);
+	if (err)
+		return err;
+
+	xone_mt76_init_usb_dma(mt);
 
 	err = xone_mt76_calibrate_crystal(mt);
 	if (err)
@@ -933,16 +1459,52 @@ int xone_mt76_init_radio(struct xone_mt76 *mt)
 	if (err)
 		return err;
 
-	err = xone_mt76_init_channels(mt);
+	err = xone_mt76_init_rx_gain(mt);
+	if (err)
+		return err;
+
+	return xone_mt76_init_channels(mt);
+}
+
+int xone_mt76_start_radio(struct xone_mt76 *mt)
+{
+	int err;
+
+	err = xone_mt76_start_channel(mt);
 	if (err)
 		return err;
 
+	xone_mt76_store_calibration(mt);
+
 	/* mandatory delay after channel change */
 	msleep(1000);
 
 	return xone_mt76_set_pairing(mt, false);
 }
 
+int xone_mt76_change_channel(struct xone_mt76 *mt,
+			     struct xone_mt76_channel *chan, bool pairing)
+{
+	int err;
+
+	dev_dbg(mt->dev, "%s: channel=%u -> %u\n", __func__,
+		mt->channel->index, chan->index);
+
+	mt->channel = chan;
+	mt->cal.channel = chan - mt->channels;
+
+	err = xone_mt76_switch_channel(mt, chan);
+	if (err)
+		return err;
+
+	/* clients follow the candidate list and the beacon */
+	err = xone_mt76_set_channel_candidates(mt);
+	if (err)
+		return err;
+
+	return xone_mt76_set_pairing(mt, pairing);
+}
+
 int xone_mt76_suspend_radio(struct xone_mt76 *mt)
 {
 	int err;
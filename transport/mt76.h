@@ -13,6 +13,9 @@
 
 #define XONE_MT_NUM_CHANNELS 12
 
+/* RX aggregation timeout (in units of 33 ns) */
+#define XONE_MT_RX_AGG_TIMEOUT 0x80
+
 /* 802.11 frame subtype: reserved */
 #define XONE_MT_WLAN_RESERVED 0x70
 
@@ -37,6 +40,32 @@ struct xone_mt76_channel {
 	enum mt76_cal_channel_group group;
 	bool scan;
 	u8 power;
+
+	/* channel activity in per mille of the measured time */
+	u16 busy;
+	u16 energy;
+	u16 cca_errors;
+
+	/* transmissions without acknowledgment in per mille */
+	u16 tx_failures;
+
+	/* time of the last measurement, zero if there is none */
+	ktime_t surveyed;
+};
+
+/* per-dongle radio calibration, reused by later probes */
+struct xone_mt76_calibration {
+	u8 address[ETH_ALEN];
+	u16 crystal;
+	u8 power[XONE_MT_NUM_CHANNELS];
+	u8 channel;
+
+	/* channel activity measured by the sweep */
+	u16 busy[XONE_MT_NUM_CHANNELS];
+	u16 energy[XONE_MT_NUM_CHANNELS];
+
+	/* RSSI offset and LNA gain correction of the first chain */
+	s16 rssi_offset[XONE_MT_NUM_CHANNELS];
 };
 
 struct xone_mt76 {
@@ -46,20 +75,47 @@ struct xone_mt76 {
 	__le32 control_data;
 	u8 address[ETH_ALEN];
 
+	/* RX aggregation limit in KiB (0 = disabled) */
+	u8 rx_agg_limit;
+
 	struct xone_mt76_channel channels[XONE_MT_NUM_CHANNELS];
 	struct xone_mt76_channel *channel;
+
+	/* channels overlapping with other dongles (by table position) */
+	u16 channels_used;
+
+	struct xone_mt76_calibration cal;
+	bool calibrated;
 };
 
 struct sk_buff *xone_mt76_alloc_message(int len, gfp_t gfp);
 void xone_mt76_prep_command(struct sk_buff *skb, enum mt76_mcu_cmd cmd);
+int xone_mt76_prep_command_buffer(u8 *buf, int len, enum mt76_mcu_cmd cmd);
 
 int xone_mt76_set_led_mode(struct xone_mt76 *mt, enum xone_mt76_led_mode mode);
 int xone_mt76_load_firmware(struct xone_mt76 *mt, const char *name);
+void xone_mt76_free_firmware(void);
 int xone_mt76_init_radio(struct xone_mt76 *mt);
+int xone_mt76_start_radio(struct xone_mt76 *mt);
 int xone_mt76_suspend_radio(struct xone_mt76 *mt);
 int xone_mt76_resume_radio(struct xone_mt76 *mt);
 int xone_mt76_set_pairing(struct xone_mt76 *mt, bool enable);
 
+void xone_mt76_survey_channel(struct xone_mt76 *mt,
+			      struct xone_mt76_channel *chan);
+int xone_mt76_get_channel_load(const struct xone_mt76_channel *chan);
+void xone_mt76_avoid_channel(struct xone_mt76 *mt,
+			     const struct xone_mt76_channel *chan);
+bool xone_mt76_channel_used(struct xone_mt76 *mt,
+			    struct xone_mt76_channel *chan);
+struct xone_mt76_channel *xone_mt76_find_channel(struct xone_mt76 *mt);
+void xone_mt76_select_channel(struct xone_mt76 *mt);
+int xone_mt76_survey_candidate(struct xone_mt76 *mt,
+			       struct xone_mt76_channel *chan);
+int xone_mt76_get_rssi(struct xone_mt76 *mt, s8 rssi);
+int xone_mt76_change_channel(struct xone_mt76 *mt,
+			     struct xone_mt76_channel *chan, bool pairing);
+
 int xone_mt76_pair_client(struct xone_mt76 *mt, u8 *addr);
 int xone_mt76_associate_client(struct xone_mt76 *mt, u8 wcid, u8 *addr);
 int xone_mt76_remove_client(struct xone_mt76 *mt, u8 wcid);
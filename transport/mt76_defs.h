@@ -563,7 +563,11 @@
 #define MT_RX_STAT_2_OVERFLOW_ERRORS GENMASK(31, 16)
 
 #define MT_TX_STA_0 0x170c
+#define MT_TX_STA_0_FAILURES GENMASK(15, 0)
+
 #define MT_TX_STA_1 0x1710
+#define MT_TX_STA_1_SUCCESSES GENMASK(15, 0)
+
 #define MT_TX_STA_2 0x1714
 
 #define MT_TX_STAT_FIFO 0x1718
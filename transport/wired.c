@@ -5,7 +5,9 @@
 
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/sysfs.h>
 #include <linux/usb.h>
+#include <linux/pm_runtime.h>
 
 #include "../bus/bus.h"
 
@@ -13,11 +15,33 @@
 #define XONE_WIRED_INTF_AUDIO 1
 
 #define XONE_WIRED_NUM_DATA_URBS 8
+#define XONE_WIRED_NUM_DATA_IN_URBS 4
+#define XONE_WIRED_MAX_DATA_IN_URBS 32
 #define XONE_WIRED_NUM_AUDIO_URBS 12
+#define XONE_WIRED_NUM_AUDIO_IN_URBS 3
 #define XONE_WIRED_NUM_AUDIO_PKTS 8
+#define XONE_WIRED_NUM_AUDIO_DEPTH 2
 
 #define XONE_WIRED_LEN_DATA_PKT 64
 
+/* completions without underrun before reducing the pipeline depth */
+#define XONE_WIRED_AUDIO_DEPTH_DECAY 1250
+
+/* time for pending output to complete before an endpoint reset (in ms) */
+#define XONE_WIRED_TX_TIMEOUT 100
+
+/* maximum number of URBs processed per RX work run */
+#define XONE_WIRED_MAX_RX_BUDGET 64
+
+/* alignment of the buffers within the coherent region */
+#define XONE_WIRED_BUF_ALIGN 64
+
+/* autosuspend delay in ms */
+#define XONE_WIRED_SUSPEND_DELAY 60000
+
+/* frame numbers are 11 bits wide */
+#define XONE_WIRED_FRAME_MASK 0x07ff
+
 #define XONE_WIRED_VENDOR(vendor) \
 	.match_flags = USB_DEVICE_ID_MATCH_VENDOR | \
 		       USB_DEVICE_ID_MATCH_INT_INFO | \
@@ -37,20 +61,167 @@ struct xone_wired {
 		struct usb_endpoint_descriptor *ep_in;
 		struct usb_endpoint_descriptor *ep_out;
 
-		struct urb *urb_in;
+		struct usb_anchor urbs_in_idle;
+		struct usb_anchor urbs_in_busy;
 		struct usb_anchor urbs_out_idle;
 		struct usb_anchor urbs_out_busy;
 
 		int buffer_length_out;
+		int interval_out;
 	} data_port, audio_port;
 
+	/* playback URBs waiting for the packet layout of the audio format */
+	struct usb_anchor urbs_audio_out;
+
+	/* output is deferred while reconfiguring or suspended */
+	spinlock_t tx_lock;
+	bool tx_stopped;
+	bool suspended;
+	struct usb_anchor urbs_out_deferred;
+	struct work_struct waker;
+
+	bool audio_in_active;
+
+	/* deferred processing of interrupt IN URBs */
+	struct usb_anchor urbs_in_done;
+	struct work_struct rx_work;
+	int rx_budget;
+	int rx_cpu;
+
+	/* serializes polling interval changes */
+	struct mutex poll_lock;
+	unsigned int poll_interval;
+	u8 default_interval_in;
+	u8 default_interval_out;
+
+	/* capture statistics, updated from URB completion */
+	int audio_frames_per_urb;
+	int audio_next_frame;
+	u32 audio_gaps;
+	u32 audio_errors;
+
+	/* playback statistics, updated from URB completion */
+	ktime_t audio_last_out;
+	bool audio_continuous;
+	int audio_clean_outs;
+	u32 audio_underruns;
+	u32 audio_overruns;
+
+	/* single coherent region for all URB buffers */
+	void *dma_buf;
+	dma_addr_t dma_addr;
+	size_t dma_len;
+	size_t dma_used;
+
 	struct gip_adapter *adapter;
 };
 
+static uint xone_wired_num_data_in_urbs = XONE_WIRED_NUM_DATA_IN_URBS;
+module_param_named(in_urbs, xone_wired_num_data_in_urbs, uint, 0444);
+MODULE_PARM_DESC(in_urbs, "Number of interrupt IN URBs in flight (1-32)");
+
+static uint xone_wired_poll_interval;
+module_param_named(poll_interval, xone_wired_poll_interval, uint, 0644);
+MODULE_PARM_DESC(poll_interval,
+		 "Polling interval of new devices in ms (0-255, 0 = default)");
+
+static uint xone_wired_audio_depth = XONE_WIRED_NUM_AUDIO_DEPTH;
+module_param_named(audio_depth, xone_wired_audio_depth, uint, 0644);
+MODULE_PARM_DESC(audio_depth, "Minimum number of queued playback URBs (1-12)");
+
+static uint xone_wired_rx_budget;
+module_param_named(rx_budget, xone_wired_rx_budget, uint, 0644);
+MODULE_PARM_DESC(rx_budget,
+		 "URBs processed per RX work run (0 = process in completion)");
+
+static int xone_wired_rx_cpu = -1;
+module_param_named(rx_cpu, xone_wired_rx_cpu, int, 0644);
+MODULE_PARM_DESC(rx_cpu, "CPU used for RX processing (-1 = any)");
+
+static void xone_wired_process_data_in(struct xone_wired *wired,
+				       struct urb *urb)
+{
+	int err;
+
+	if (!urb->actual_length)
+		return;
+
+	usb_mark_last_busy(wired->udev);
+
+	err = gip_process_buffer(wired->adapter, urb->transfer_buffer,
+				 urb->actual_length);
+	if (err) {
+		dev_err(wired->data_port.dev, "%s: process failed: %d\n",
+			__func__, err);
+		print_hex_dump_debug("xone-wired packet: ",
+				     DUMP_PREFIX_NONE, 16, 1,
+				     urb->transfer_buffer, urb->actual_length,
+				     false);
+	}
+}
+
+static void xone_wired_queue_rx(struct xone_wired *wired)
+{
+	int cpu = READ_ONCE(wired->rx_cpu);
+
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu))
+		cpu = WORK_CPU_UNBOUND;
+
+	queue_work_on(cpu, system_highpri_wq, &wired->rx_work);
+}
+
+static void xone_wired_process_rx(struct work_struct *work)
+{
+	struct xone_wired *wired = container_of(work, typeof(*wired),
+						rx_work);
+	struct xone_wired_port *port = &wired->data_port;
+	int budget = READ_ONCE(wired->rx_budget) ?: XONE_WIRED_MAX_RX_BUDGET;
+	struct urb *urb;
+	int err;
+
+	/* anchor preserves the completion order */
+	while (budget-- && (urb = usb_get_from_anchor(&wired->urbs_in_done))) {
+		xone_wired_process_data_in(wired, urb);
+		usb_anchor_urb(urb, &port->urbs_in_busy);
+
+		/* can fail during USB device removal */
+		err = usb_submit_urb(urb, GFP_KERNEL);
+		if (err) {
+			dev_dbg(port->dev, "%s: submit failed: %d\n",
+				__func__, err);
+			usb_unanchor_urb(urb);
+			usb_anchor_urb(urb, &port->urbs_in_idle);
+		}
+
+		usb_free_urb(urb);
+	}
+
+	/* yield to other work items if budget is exhausted */
+	if (!usb_anchor_empty(&wired->urbs_in_done))
+		xone_wired_queue_rx(wired);
+}
+
+static void xone_wired_stop_rx(struct xone_wired *wired)
+{
+	struct xone_wired_port *port = &wired->data_port;
+	struct urb *urb;
+
+	/* RX work can resubmit URBs until it has been cancelled */
+	usb_kill_anchored_urbs(&port->urbs_in_busy);
+	cancel_work_sync(&wired->rx_work);
+	usb_kill_anchored_urbs(&port->urbs_in_busy);
+
+	while ((urb = usb_get_from_anchor(&wired->urbs_in_done))) {
+		usb_anchor_urb(urb, &port->urbs_in_idle);
+		usb_free_urb(urb);
+	}
+}
+
 static void xone_wired_complete_data_in(struct urb *urb)
 {
 	struct xone_wired *wired = urb->context;
-	struct device *dev = wired->data_port.dev;
+	struct xone_wired_port *port = &wired->data_port;
+	struct device *dev = port->dev;
 	int err;
 
 	switch (urb->status) {
@@ -59,337 +230,1015 @@ static void xone_wired_complete_data_in(struct urb *urb)
 	case -ENOENT:
 	case -ECONNRESET:
 	case -ESHUTDOWN:
+		usb_anchor_urb(urb, &port->urbs_in_idle);
 		return;
 	default:
 		goto resubmit;
 	}
 
-	if (!urb->actual_length)
-		goto resubmit;
-
-	err = gip_process_buffer(wired->adapter, urb->transfer_buffer,
-				 urb->actual_length);
-	if (err) {
-		dev_err(dev, "%s: process failed: %d\n", __func__, err);
-		print_hex_dump_debug("xone-wired packet: ",
-				     DUMP_PREFIX_NONE, 16, 1,
-				     urb->transfer_buffer, urb->actual_length,
-				     false);
+	/*
+	 * Defer processing while previous buffers are pending or the work
+	 * still runs, so switching the budget to 0 never reorders packets.
+	 */
+	if (READ_ONCE(wired->rx_budget) || work_busy(&wired->rx_work) ||
+	    !usb_anchor_empty(&wired->urbs_in_done)) {
+		usb_anchor_urb(urb, &wired->urbs_in_done);
+		xone_wired_queue_rx(wired);
+		return;
 	}
 
+	xone_wired_process_data_in(wired, urb);
+
 resubmit:
+	/* completions of the same endpoint are always in order */
+	usb_anchor_urb(urb, &port->urbs_in_busy);
+
 	/* can fail during USB device removal */
 	err = usb_submit_urb(urb, GFP_ATOMIC);
-	if (err)
+	if (err) {
 		dev_dbg(dev, "%s: submit failed: %d\n", __func__, err);
+		usb_unanchor_urb(urb);
+		usb_anchor_urb(urb, &port->urbs_in_idle);
+	}
+}
+
+static void xone_wired_check_audio_frame(struct xone_wired *wired,
+					 struct urb *urb)
+{
+	int frame = urb->start_frame & XONE_WIRED_FRAME_MASK;
+
+	/* detect service intervals without a capture URB */
+	if (wired->audio_next_frame >= 0 && frame != wired->audio_next_frame) {
+		wired->audio_gaps++;
+		dev_dbg(wired->audio_port.dev, "%s: expected=%d, actual=%d\n",
+			__func__, wired->audio_next_frame, frame);
+	}
+
+	wired->audio_next_frame = (frame + wired->audio_frames_per_urb) &
+				  XONE_WIRED_FRAME_MASK;
 }
 
 static void xone_wired_complete_audio_in(struct urb *urb)
 {
 	struct xone_wired *wired = urb->context;
-	struct device *dev = wired->audio_port.dev;
+	struct xone_wired_port *port = &wired->audio_port;
+	struct device *dev = port->dev;
 	struct usb_iso_packet_descriptor *desc;
 	int i, err;
 
-	if (urb->status)
+	switch (urb->status) {
+	case 0:
+		break;
+	case -ENOENT:
+	case -ECONNRESET:
+	case -ESHUTDOWN:
+		usb_anchor_urb(urb, &port->urbs_in_idle);
 		return;
+	default:
+		/* resynchronize the gap detection with the next URB */
+		wired->audio_errors++;
+		wired->audio_next_frame = -1;
+		goto resubmit;
+	}
+
+	xone_wired_check_audio_frame(wired, urb);
 
 	for (i = 0; i < urb->number_of_packets; i++) {
 		desc = &urb->iso_frame_desc[i];
 
+		if (desc->status)
+			wired->audio_errors++;
+
 		/* device reset after system sleep can cause xHCI errors */
 		if (desc->status == -EPROTO) {
 			dev_warn_once(dev, "%s: protocol error\n", __func__);
 			break;
 		}
 
-		if (!desc->actual_length)
-			continue;
+		if (!desc->actual_length)
+			continue;
+
+		err = gip_process_buffer(wired->adapter,
+					 urb->transfer_buffer + desc->offset,
+					 desc->actual_length);
+		if (err)
+			dev_err(dev, "%s: process failed: %d\n", __func__, err);
+	}
+
+resubmit:
+	usb_anchor_urb(urb, &port->urbs_in_busy);
+
+	/* can fail during USB device removal */
+	err = usb_submit_urb(urb, GFP_ATOMIC);
+	if (err) {
+		dev_dbg(dev, "%s: submit failed: %d\n", __func__, err);
+		usb_unanchor_urb(urb);
+		usb_anchor_urb(urb, &port->urbs_in_idle);
+	}
+}
+
+static void xone_wired_complete_out(struct urb *urb)
+{
+	struct xone_wired_port *port = urb->context;
+
+	usb_anchor_urb(urb, &port->urbs_out_idle);
+}
+
+static void xone_wired_update_audio_rate(struct xone_wired *wired,
+					 bool underrun)
+{
+	struct gip_adapter *adap = wired->adapter;
+	ktime_t now = ktime_get();
+	s64 nominal = GIP_AUDIO_INTERVAL * NSEC_PER_MSEC;
+	s64 interval = adap->audio_interval ?: nominal;
+	s64 delta = ktime_to_ns(ktime_sub(now, wired->audio_last_out));
+
+	/* only continuous playback reflects the consumption rate */
+	if (wired->audio_continuous) {
+		/* ignore scheduling outliers */
+		delta = clamp(delta, nominal * 15 / 16, nominal * 17 / 16);
+		interval += (delta - interval) / 16;
+	}
+
+	wired->audio_last_out = now;
+	wired->audio_continuous = !underrun;
+	WRITE_ONCE(adap->audio_interval, interval);
+}
+
+static void xone_wired_complete_audio_out(struct urb *urb)
+{
+	struct xone_wired *wired = urb->context;
+	struct gip_adapter *adap = wired->adapter;
+	int depth = READ_ONCE(adap->audio_depth);
+	int min_depth = clamp_val(xone_wired_audio_depth, 1,
+				  XONE_WIRED_NUM_AUDIO_URBS);
+	bool underrun;
+
+	usb_anchor_urb(urb, &wired->audio_port.urbs_out_idle);
+
+	underrun = !atomic_dec_return(&adap->audio_pending);
+	if (urb->status)
+		return;
+
+	xone_wired_update_audio_rate(wired, underrun);
+
+	/* increase latency if the device ran out of samples */
+	if (underrun) {
+		wired->audio_underruns++;
+		wired->audio_clean_outs = 0;
+
+		if (depth < XONE_WIRED_NUM_AUDIO_URBS)
+			WRITE_ONCE(adap->audio_depth, depth + 1);
+
+		return;
+	}
+
+	if (++wired->audio_clean_outs < XONE_WIRED_AUDIO_DEPTH_DECAY)
+		return;
+
+	wired->audio_clean_outs = 0;
+
+	if (depth > min_depth)
+		WRITE_ONCE(adap->audio_depth, depth - 1);
+}
+
+static u8 xone_wired_get_interval(struct xone_wired *wired, u8 def)
+{
+	unsigned int interval = wired->poll_interval;
+
+	if (!interval)
+		return def;
+
+	/* encoded as exponent for high speed (in 125 μs units) */
+	if (wired->udev->speed >= USB_SPEED_HIGH)
+		return min(fls(interval << 3), 16);
+
+	return min(interval, 255u);
+}
+
+static int xone_wired_get_urb_interval(struct xone_wired *wired, u8 interval)
+{
+	/* same conversion as usb_fill_int_urb */
+	if (wired->udev->speed >= USB_SPEED_HIGH)
+		return 1 << (clamp_val(interval, 1, 16) - 1);
+
+	return interval;
+}
+
+static void xone_wired_apply_interval(struct xone_wired *wired)
+{
+	struct xone_wired_port *port = &wired->data_port;
+
+	/* the host controller schedules based on the endpoint descriptor */
+	port->ep_in->bInterval = xone_wired_get_interval(wired,
+						wired->default_interval_in);
+	port->ep_out->bInterval = xone_wired_get_interval(wired,
+						wired->default_interval_out);
+	port->interval_out = xone_wired_get_urb_interval(wired,
+						port->ep_out->bInterval);
+}
+
+static int xone_wired_get_num_data_in_urbs(void)
+{
+	/* keep multiple URBs in flight to avoid missing an interval */
+	return clamp_val(xone_wired_num_data_in_urbs, 1,
+			 XONE_WIRED_MAX_DATA_IN_URBS);
+}
+
+static int xone_wired_init_dma(struct xone_wired *wired)
+{
+	struct xone_wired_port *port = &wired->audio_port;
+	size_t len;
+
+	/* sized for the maximum configuration */
+	len = (xone_wired_get_num_data_in_urbs() + XONE_WIRED_NUM_DATA_URBS) *
+	      ALIGN(XONE_WIRED_LEN_DATA_PKT, XONE_WIRED_BUF_ALIGN);
+
+	if (port->ep_in)
+		len += XONE_WIRED_NUM_AUDIO_IN_URBS *
+		       ALIGN(usb_endpoint_maxp(port->ep_in) *
+			     XONE_WIRED_NUM_AUDIO_PKTS, XONE_WIRED_BUF_ALIGN);
+
+	if (port->ep_out)
+		len += XONE_WIRED_NUM_AUDIO_URBS *
+		       ALIGN(usb_endpoint_maxp(port->ep_out) *
+			     XONE_WIRED_NUM_AUDIO_PKTS, XONE_WIRED_BUF_ALIGN);
+
+	wired->dma_buf = usb_alloc_coherent(wired->udev, len, GFP_KERNEL,
+					    &wired->dma_addr);
+	if (!wired->dma_buf)
+		return -ENOMEM;
+
+	wired->dma_len = len;
+	wired->dma_used = 0;
+
+	return 0;
+}
+
+static void xone_wired_free_dma(struct xone_wired *wired)
+{
+	if (!wired->dma_buf)
+		return;
+
+	usb_free_coherent(wired->udev, wired->dma_len, wired->dma_buf,
+			  wired->dma_addr);
+	wired->dma_buf = NULL;
+}
+
+static struct urb *xone_wired_alloc_urb(struct xone_wired *wired,
+					struct usb_anchor *anchor,
+					int pkts, int len)
+{
+	size_t offset = wired->dma_used;
+	struct urb *urb;
+
+	if (offset + len > wired->dma_len)
+		return NULL;
+
+	urb = usb_alloc_urb(pkts, GFP_KERNEL);
+	if (!urb)
+		return NULL;
+
+	usb_anchor_urb(urb, anchor);
+	usb_free_urb(urb);
+
+	/* carve buffer out of the coherent region */
+	urb->transfer_buffer = wired->dma_buf + offset;
+	urb->transfer_dma = wired->dma_addr + offset;
+	urb->transfer_buffer_length = len;
+	urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
+	wired->dma_used += ALIGN(len, XONE_WIRED_BUF_ALIGN);
+
+	return urb;
+}
+
+static int xone_wired_submit_data_in(struct xone_wired *wired)
+{
+	struct xone_wired_port *port = &wired->data_port;
+	struct urb *urb;
+	int err;
+
+	while ((urb = usb_get_from_anchor(&port->urbs_in_idle))) {
+		urb->interval = xone_wired_get_urb_interval(wired,
+						port->ep_in->bInterval);
+		usb_anchor_urb(urb, &port->urbs_in_busy);
+
+		err = usb_submit_urb(urb, GFP_KERNEL);
+		if (err) {
+			usb_unanchor_urb(urb);
+			usb_anchor_urb(urb, &port->urbs_in_idle);
+			usb_free_urb(urb);
+			return err;
+		}
+
+		usb_free_urb(urb);
+	}
+
+	return 0;
+}
+
+static int xone_wired_init_data_in(struct xone_wired *wired)
+{
+	struct xone_wired_port *port = &wired->data_port;
+	struct urb *urb;
+	int i;
+
+	for (i = 0; i < xone_wired_get_num_data_in_urbs(); i++) {
+		urb = xone_wired_alloc_urb(wired, &port->urbs_in_idle, 0,
+					   XONE_WIRED_LEN_DATA_PKT);
+		if (!urb)
+			return -ENOMEM;
+
+		usb_fill_int_urb(urb, wired->udev,
+				 usb_rcvintpipe(wired->udev,
+						port->ep_in->bEndpointAddress),
+				 urb->transfer_buffer, XONE_WIRED_LEN_DATA_PKT,
+				 xone_wired_complete_data_in, wired,
+				 port->ep_in->bInterval);
+	}
+
+	return xone_wired_submit_data_in(wired);
+}
+
+static int xone_wired_init_data_out(struct xone_wired *wired)
+{
+	struct xone_wired_port *port = &wired->data_port;
+	struct urb *urb;
+	int i;
+
+	port->buffer_length_out = XONE_WIRED_LEN_DATA_PKT;
+
+	for (i = 0; i < XONE_WIRED_NUM_DATA_URBS; i++) {
+		urb = xone_wired_alloc_urb(wired, &port->urbs_out_idle, 0,
+					   XONE_WIRED_LEN_DATA_PKT);
+		if (!urb)
+			return -ENOMEM;
+
+		usb_fill_int_urb(urb, wired->udev,
+				 usb_sndintpipe(wired->udev,
+						port->ep_out->bEndpointAddress),
+				 urb->transfer_buffer, XONE_WIRED_LEN_DATA_PKT,
+				 xone_wired_complete_out, port,
+				 port->ep_out->bInterval);
+	}
+
+	return 0;
+}
+
+static int xone_wired_init_audio_urbs(struct xone_wired *wired)
+{
+	struct xone_wired_port *port = &wired->audio_port;
+	struct urb *urb;
+	int len, i, j;
+
+	if (!port->ep_in || !port->ep_out)
+		return 0;
+
+	/* allocated once, reused whenever audio is enabled */
+	len = usb_endpoint_maxp(port->ep_in);
+
+	for (i = 0; i < XONE_WIRED_NUM_AUDIO_IN_URBS; i++) {
+		urb = xone_wired_alloc_urb(wired, &port->urbs_in_idle,
+					   XONE_WIRED_NUM_AUDIO_PKTS,
+					   len * XONE_WIRED_NUM_AUDIO_PKTS);
+		if (!urb)
+			return -ENOMEM;
+
+		urb->dev = wired->udev;
+		urb->pipe = usb_rcvisocpipe(wired->udev,
+					    port->ep_in->bEndpointAddress);
+		urb->transfer_flags |= URB_ISO_ASAP;
+		urb->number_of_packets = XONE_WIRED_NUM_AUDIO_PKTS;
+		urb->interval = port->ep_in->bInterval;
+		urb->context = wired;
+		urb->complete = xone_wired_complete_audio_in;
+
+		for (j = 0; j < XONE_WIRED_NUM_AUDIO_PKTS; j++) {
+			urb->iso_frame_desc[j].offset = j * len;
+			urb->iso_frame_desc[j].length = len;
+		}
+	}
+
+	len = usb_endpoint_maxp(port->ep_out);
+
+	for (i = 0; i < XONE_WIRED_NUM_AUDIO_URBS; i++) {
+		urb = xone_wired_alloc_urb(wired, &wired->urbs_audio_out,
+					   XONE_WIRED_NUM_AUDIO_PKTS,
+					   len * XONE_WIRED_NUM_AUDIO_PKTS);
+		if (!urb)
+			return -ENOMEM;
+
+		urb->dev = wired->udev;
+		urb->pipe = usb_sndisocpipe(wired->udev,
+					    port->ep_out->bEndpointAddress);
+		urb->transfer_flags |= URB_ISO_ASAP;
+		urb->number_of_packets = XONE_WIRED_NUM_AUDIO_PKTS;
+		urb->interval = port->ep_out->bInterval;
+		urb->context = wired;
+		urb->complete = xone_wired_complete_audio_out;
+	}
+
+	return 0;
+}
+
+static void xone_wired_free_urbs(struct xone_wired_port *port)
+{
+	struct urb *urb;
+
+	/* buffers are part of the coherent region */
+	while ((urb = usb_get_from_anchor(&port->urbs_in_idle)))
+		usb_free_urb(urb);
+
+	while ((urb = usb_get_from_anchor(&port->urbs_out_idle)))
+		usb_free_urb(urb);
+}
+
+static void xone_wired_park_audio_out(struct xone_wired *wired)
+{
+	struct urb *urb;
+
+	/* unusable until the next audio format is configured */
+	while ((urb = usb_get_from_anchor(&wired->audio_port.urbs_out_idle))) {
+		usb_anchor_urb(urb, &wired->urbs_audio_out);
+		usb_free_urb(urb);
+	}
+}
+
+static void xone_wired_free_audio_out(struct xone_wired *wired)
+{
+	struct urb *urb;
+
+	while ((urb = usb_get_from_anchor(&wired->urbs_audio_out)))
+		usb_free_urb(urb);
+}
+
+static int xone_wired_get_buffer(struct gip_adapter *adap,
+				 struct gip_adapter_buffer *buf)
+{
+	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
+	struct xone_wired_port *port;
+	struct urb *urb;
+
+	if (buf->type == GIP_BUF_DATA)
+		port = &wired->data_port;
+	else if (buf->type == GIP_BUF_AUDIO)
+		port = &wired->audio_port;
+	else
+		return -EINVAL;
+
+	urb = usb_get_from_anchor(&port->urbs_out_idle);
+	if (!urb) {
+		if (buf->type == GIP_BUF_AUDIO)
+			wired->audio_overruns++;
+
+		return -ENOSPC;
+	}
+
+	buf->context = urb;
+	buf->data = urb->transfer_buffer;
+	buf->length = port->buffer_length_out;
+
+	return 0;
+}
+
+static int xone_wired_submit_buffer(struct gip_adapter *adap,
+				    struct gip_adapter_buffer *buf)
+{
+	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
+	struct xone_wired_port *port;
+	struct urb *urb = buf->context;
+	unsigned long flags;
+	int err;
+
+	if (buf->type == GIP_BUF_DATA)
+		port = &wired->data_port;
+	else if (buf->type == GIP_BUF_AUDIO)
+		port = &wired->audio_port;
+	else
+		return -EINVAL;
+
+	urb->transfer_buffer_length = buf->length;
+	urb->interval = port->interval_out;
+
+	/* submission is atomic with respect to xone_wired_stop_tx */
+	spin_lock_irqsave(&wired->tx_lock, flags);
+
+	if (buf->type == GIP_BUF_DATA &&
+	    (wired->tx_stopped || wired->suspended)) {
+		/* submitted after the device has been resumed */
+		if (wired->suspended)
+			schedule_work(&wired->waker);
+
+		usb_anchor_urb(urb, &wired->urbs_out_deferred);
+		spin_unlock_irqrestore(&wired->tx_lock, flags);
+		usb_free_urb(urb);
+		return 0;
+	}
+
+	/* audio keeps the device awake, except during system sleep */
+	if (wired->suspended) {
+		usb_anchor_urb(urb, &port->urbs_out_idle);
+		spin_unlock_irqrestore(&wired->tx_lock, flags);
+		usb_free_urb(urb);
+		return -ESHUTDOWN;
+	}
+
+	usb_mark_last_busy(wired->udev);
+	usb_anchor_urb(urb, &port->urbs_out_busy);
+
+	if (buf->type == GIP_BUF_AUDIO)
+		atomic_inc(&adap->audio_pending);
+
+	err = usb_submit_urb(urb, GFP_ATOMIC);
+	if (err) {
+		if (buf->type == GIP_BUF_AUDIO)
+			atomic_dec(&adap->audio_pending);
+
+		usb_unanchor_urb(urb);
+		usb_anchor_urb(urb, &port->urbs_out_idle);
+	}
+
+	spin_unlock_irqrestore(&wired->tx_lock, flags);
+	usb_free_urb(urb);
+
+	return err;
+}
+
+static void xone_wired_release_buffer(struct gip_adapter *adap,
+				      struct gip_adapter_buffer *buf)
+{
+	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
+	struct urb *urb = buf->context;
+
+	if (buf->type == GIP_BUF_DATA)
+		usb_anchor_urb(urb, &wired->data_port.urbs_out_idle);
+	else
+		usb_anchor_urb(urb, &wired->audio_port.urbs_out_idle);
+
+	usb_free_urb(urb);
+}
+
+static int xone_wired_enable_audio(struct gip_adapter *adap)
+{
+	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
+	struct usb_interface *data = to_usb_interface(wired->data_port.dev);
+	struct usb_interface *intf;
+	int err;
+
+	if (!wired->audio_port.dev)
+		return -ENOTSUPP;
+
+	intf = to_usb_interface(wired->audio_port.dev);
+	if (intf->cur_altsetting->desc.bAlternateSetting == 1)
+		return -EALREADY;
+
+	/* prevent autosuspend while audio is enabled */
+	err = usb_autopm_get_interface(data);
+	if (err)
+		return err;
+
+	err = usb_set_interface(wired->udev, XONE_WIRED_INTF_AUDIO, 1);
+	if (err)
+		usb_autopm_put_interface(data);
+
+	return err;
+}
+
+static int xone_wired_submit_audio_in(struct xone_wired *wired)
+{
+	struct xone_wired_port *port = &wired->audio_port;
+	struct urb *urb;
+	int err;
+
+	/* multiple URBs avoid gaps between resubmissions */
+	while ((urb = usb_get_from_anchor(&port->urbs_in_idle))) {
+		usb_anchor_urb(urb, &port->urbs_in_busy);
+
+		err = usb_submit_urb(urb, GFP_KERNEL);
+		if (err) {
+			usb_unanchor_urb(urb);
+			usb_anchor_urb(urb, &port->urbs_in_idle);
+			usb_free_urb(urb);
+			return err;
+		}
+
+		usb_free_urb(urb);
+	}
+
+	return 0;
+}
+
+static int xone_wired_init_audio_in(struct gip_adapter *adap)
+{
+	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
+	struct xone_wired_port *port = &wired->audio_port;
+	int interval;
+
+	if (!port->ep_in)
+		return -ENOTSUPP;
+
+	interval = 1 << (clamp_val(port->ep_in->bInterval, 1, 16) - 1);
+	interval *= XONE_WIRED_NUM_AUDIO_PKTS;
+
+	/* interval is specified in microframes for high speed */
+	if (wired->udev->speed >= USB_SPEED_HIGH)
+		interval = DIV_ROUND_UP(interval, 8);
+
+	wired->audio_frames_per_urb = interval;
+	wired->audio_next_frame = -1;
+	wired->audio_in_active = true;
+
+	return xone_wired_submit_audio_in(wired);
+}
+
+static int xone_wired_init_audio_out(struct gip_adapter *adap, int pkt_len)
+{
+	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
+	struct xone_wired_port *port = &wired->audio_port;
+	struct urb *urb;
+	int i;
+
+	if (!port->ep_out)
+		return -ENOTSUPP;
+
+	if (pkt_len > usb_endpoint_maxp(port->ep_out))
+		return -EINVAL;
+
+	port->buffer_length_out = pkt_len * XONE_WIRED_NUM_AUDIO_PKTS;
+	port->interval_out = port->ep_out->bInterval;
+
+	adap->audio_depth = clamp_val(xone_wired_audio_depth, 1,
+				      XONE_WIRED_NUM_AUDIO_URBS);
+	adap->audio_interval = 0;
+	atomic_set(&adap->audio_pending, 0);
+	wired->audio_continuous = false;
+	wired->audio_clean_outs = 0;
+
+	xone_wired_park_audio_out(wired);
+
+	/* packet layout depends on the audio format */
+	while ((urb = usb_get_from_anchor(&wired->urbs_audio_out))) {
+		for (i = 0; i < XONE_WIRED_NUM_AUDIO_PKTS; i++) {
+			urb->iso_frame_desc[i].offset = i * pkt_len;
+			urb->iso_frame_desc[i].length = pkt_len;
+		}
+
+		usb_anchor_urb(urb, &port->urbs_out_idle);
+		usb_free_urb(urb);
+	}
+
+	return 0;
+}
+
+static int xone_wired_disable_audio(struct gip_adapter *adap)
+{
+	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
+	struct xone_wired_port *port = &wired->audio_port;
+	struct usb_interface *intf;
+	int err;
+
+	if (!port->dev)
+		return -ENOTSUPP;
+
+	intf = to_usb_interface(port->dev);
+	if (!intf->cur_altsetting->desc.bAlternateSetting)
+		return -EALREADY;
+
+	wired->audio_in_active = false;
+	usb_kill_anchored_urbs(&port->urbs_in_busy);
+	usb_kill_anchored_urbs(&port->urbs_out_busy);
+	xone_wired_park_audio_out(wired);
+
+	/* fall back to fixed pacing */
+	adap->audio_depth = 0;
+	adap->audio_interval = 0;
+
+	err = usb_set_interface(wired->udev, XONE_WIRED_INTF_AUDIO, 0);
+	usb_autopm_put_interface(to_usb_interface(wired->data_port.dev));
+
+	return err;
+}
+
+static void xone_wired_wake_up(struct work_struct *work)
+{
+	struct xone_wired *wired = container_of(work, typeof(*wired), waker);
+	struct usb_interface *intf = to_usb_interface(wired->data_port.dev);
+	int err;
 
-		err = gip_process_buffer(wired->adapter,
-					 urb->transfer_buffer + desc->offset,
-					 desc->actual_length);
-		if (err)
-			dev_err(dev, "%s: process failed: %d\n", __func__, err);
+	/* resume submits the deferred URBs */
+	err = usb_autopm_get_interface(intf);
+	if (err) {
+		dev_dbg(&intf->dev, "%s: resume failed: %d\n", __func__, err);
+		return;
 	}
 
-	/* can fail during USB device removal */
-	err = usb_submit_urb(urb, GFP_ATOMIC);
-	if (err)
-		dev_dbg(dev, "%s: submit failed: %d\n", __func__, err);
+	usb_autopm_put_interface(intf);
 }
 
-static void xone_wired_complete_out(struct urb *urb)
+static struct gip_adapter_ops xone_wired_adapter_ops = {
+	.get_buffer = xone_wired_get_buffer,
+	.submit_buffer = xone_wired_submit_buffer,
+	.release_buffer = xone_wired_release_buffer,
+	.enable_audio = xone_wired_enable_audio,
+	.init_audio_in = xone_wired_init_audio_in,
+	.init_audio_out = xone_wired_init_audio_out,
+	.disable_audio = xone_wired_disable_audio,
+};
+
+static void xone_wired_stop_tx(struct xone_wired *wired)
 {
-	struct xone_wired_port *port = urb->context;
+	struct xone_wired_port *port = &wired->data_port;
 
-	usb_anchor_urb(urb, &port->urbs_out_idle);
+	spin_lock_irq(&wired->tx_lock);
+	wired->tx_stopped = true;
+	spin_unlock_irq(&wired->tx_lock);
+
+	/* endpoint reset would discard pending output */
+	if (!usb_wait_anchor_empty_timeout(&port->urbs_out_busy,
+					   XONE_WIRED_TX_TIMEOUT))
+		usb_kill_anchored_urbs(&port->urbs_out_busy);
 }
 
-static int xone_wired_init_data_in(struct xone_wired *wired)
+static void xone_wired_submit_deferred(struct xone_wired *wired)
 {
 	struct xone_wired_port *port = &wired->data_port;
 	struct urb *urb;
-	void *buf;
+	int err;
 
-	urb = usb_alloc_urb(0, GFP_KERNEL);
-	if (!urb)
-		return -ENOMEM;
+	lockdep_assert_held(&wired->tx_lock);
 
-	port->urb_in = urb;
+	/* deferred output is sent in order */
+	while ((urb = usb_get_from_anchor(&wired->urbs_out_deferred))) {
+		usb_anchor_urb(urb, &port->urbs_out_busy);
 
-	buf = usb_alloc_coherent(wired->udev, XONE_WIRED_LEN_DATA_PKT,
-				 GFP_KERNEL, &urb->transfer_dma);
-	if (!buf)
-		return -ENOMEM;
+		err = usb_submit_urb(urb, GFP_ATOMIC);
+		if (err) {
+			dev_dbg(port->dev, "%s: submit failed: %d\n",
+				__func__, err);
+			usb_unanchor_urb(urb);
+			usb_anchor_urb(urb, &port->urbs_out_idle);
+		}
 
-	usb_fill_int_urb(urb, wired->udev,
-			 usb_rcvintpipe(wired->udev,
-					port->ep_in->bEndpointAddress),
-			 buf, XONE_WIRED_LEN_DATA_PKT,
-			 xone_wired_complete_data_in, wired,
-			 port->ep_in->bInterval);
-	urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
+		usb_free_urb(urb);
+	}
+}
 
-	return usb_submit_urb(urb, GFP_KERNEL);
+static void xone_wired_start_tx(struct xone_wired *wired)
+{
+	spin_lock_irq(&wired->tx_lock);
+
+	/* sent by resume otherwise */
+	if (!wired->suspended)
+		xone_wired_submit_deferred(wired);
+
+	wired->tx_stopped = false;
+	spin_unlock_irq(&wired->tx_lock);
 }
 
-static int xone_wired_init_data_out(struct xone_wired *wired)
+static void xone_wired_drop_deferred(struct xone_wired *wired)
 {
-	struct xone_wired_port *port = &wired->data_port;
 	struct urb *urb;
-	void *buf;
-	int i;
 
-	port->buffer_length_out = XONE_WIRED_LEN_DATA_PKT;
+	while ((urb = usb_get_from_anchor(&wired->urbs_out_deferred))) {
+		usb_anchor_urb(urb, &wired->data_port.urbs_out_idle);
+		usb_free_urb(urb);
+	}
+}
 
-	for (i = 0; i < XONE_WIRED_NUM_DATA_URBS; i++) {
-		urb = usb_alloc_urb(0, GFP_KERNEL);
-		if (!urb)
-			return -ENOMEM;
+static int xone_wired_set_poll_interval(struct xone_wired *wired,
+					unsigned int interval)
+{
+	struct usb_interface *intf = to_usb_interface(wired->data_port.dev);
+	unsigned int old_interval;
+	int err;
 
-		usb_anchor_urb(urb, &port->urbs_out_idle);
-		usb_free_urb(urb);
+	err = usb_autopm_get_interface(intf);
+	if (err)
+		return err;
 
-		buf = usb_alloc_coherent(wired->udev, XONE_WIRED_LEN_DATA_PKT,
-					 GFP_KERNEL, &urb->transfer_dma);
-		if (!buf)
-			return -ENOMEM;
+	mutex_lock(&wired->poll_lock);
 
-		usb_fill_int_urb(urb, wired->udev,
-				 usb_sndintpipe(wired->udev,
-						port->ep_out->bEndpointAddress),
-				 buf, XONE_WIRED_LEN_DATA_PKT,
-				 xone_wired_complete_out, port,
-				 port->ep_out->bInterval);
-		urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
+	xone_wired_stop_rx(wired);
+	xone_wired_stop_tx(wired);
+
+	old_interval = wired->poll_interval;
+	wired->poll_interval = interval;
+	xone_wired_apply_interval(wired);
+
+	/* reconfigure the endpoints using the updated descriptors */
+	err = usb_set_interface(wired->udev, XONE_WIRED_INTF_DATA, 0);
+	if (err) {
+		dev_err(wired->data_port.dev, "%s: set interface failed: %d\n",
+			__func__, err);
+
+		/* keep the descriptors in sync with the endpoints */
+		wired->poll_interval = old_interval;
+		xone_wired_apply_interval(wired);
+		xone_wired_submit_data_in(wired);
+	} else {
+		err = xone_wired_submit_data_in(wired);
 	}
 
-	return 0;
+	xone_wired_start_tx(wired);
+	mutex_unlock(&wired->poll_lock);
+	usb_autopm_put_interface(intf);
+
+	return err;
 }
 
-static void xone_wired_free_urbs(struct xone_wired_port *port)
+static int xone_wired_init_interval(struct xone_wired *wired)
 {
-	struct urb *urb = port->urb_in;
+	struct xone_wired_port *port = &wired->data_port;
 
-	if (urb) {
-		usb_free_coherent(urb->dev, urb->transfer_buffer_length,
-				  urb->transfer_buffer, urb->transfer_dma);
-		usb_free_urb(urb);
-		port->urb_in = NULL;
-	}
+	wired->poll_interval = min(READ_ONCE(xone_wired_poll_interval), 255u);
+	wired->default_interval_in = port->ep_in->bInterval;
+	wired->default_interval_out = port->ep_out->bInterval;
+	xone_wired_apply_interval(wired);
 
-	while ((urb = usb_get_from_anchor(&port->urbs_out_idle))) {
-		usb_free_coherent(urb->dev, port->buffer_length_out,
-				  urb->transfer_buffer, urb->transfer_dma);
-		usb_free_urb(urb);
-	}
+	if (!wired->poll_interval)
+		return 0;
+
+	/* reconfigure the endpoints using the updated descriptors */
+	return usb_set_interface(wired->udev, XONE_WIRED_INTF_DATA, 0);
 }
 
-static int xone_wired_get_buffer(struct gip_adapter *adap,
-				 struct gip_adapter_buffer *buf)
+static void xone_wired_restore_interval(struct xone_wired *wired)
 {
-	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
-	struct xone_wired_port *port;
-	struct urb *urb;
-
-	if (buf->type == GIP_BUF_DATA)
-		port = &wired->data_port;
-	else if (buf->type == GIP_BUF_AUDIO)
-		port = &wired->audio_port;
-	else
-		return -EINVAL;
+	struct xone_wired_port *port = &wired->data_port;
 
-	urb = usb_get_from_anchor(&port->urbs_out_idle);
-	if (!urb)
-		return -ENOSPC;
+	/* descriptors are shared with the next driver binding */
+	port->ep_in->bInterval = wired->default_interval_in;
+	port->ep_out->bInterval = wired->default_interval_out;
+}
 
-	buf->context = urb;
-	buf->data = urb->transfer_buffer;
-	buf->length = port->buffer_length_out;
+static ssize_t poll_interval_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct xone_wired *wired = dev_get_drvdata(dev);
 
-	return 0;
+	return sprintf(buf, "%u\n", wired->poll_interval);
 }
 
-static int xone_wired_submit_buffer(struct gip_adapter *adap,
-				    struct gip_adapter_buffer *buf)
+static ssize_t poll_interval_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
 {
-	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
-	struct xone_wired_port *port;
-	struct urb *urb = buf->context;
+	struct xone_wired *wired = dev_get_drvdata(dev);
+	unsigned int interval;
 	int err;
 
-	if (buf->type == GIP_BUF_DATA)
-		port = &wired->data_port;
-	else if (buf->type == GIP_BUF_AUDIO)
-		port = &wired->audio_port;
-	else
-		return -EINVAL;
+	err = kstrtouint(buf, 10, &interval);
+	if (err)
+		return err;
 
-	urb->transfer_buffer_length = buf->length;
-	usb_anchor_urb(urb, &port->urbs_out_busy);
+	if (interval > 255)
+		return -EINVAL;
 
-	err = usb_submit_urb(urb, GFP_ATOMIC);
-	if (err) {
-		usb_unanchor_urb(urb);
-		usb_anchor_urb(urb, &port->urbs_out_idle);
-	}
+	dev_dbg(dev, "%s: interval=%u\n", __func__, interval);
 
-	usb_free_urb(urb);
+	err = xone_wired_set_poll_interval(wired, interval);
+	if (err)
+		return err;
 
-	return err;
+	return count;
 }
 
-static int xone_wired_enable_audio(struct gip_adapter *adap)
+static ssize_t poll_rate_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
 {
-	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
-	struct usb_interface *intf;
+	struct xone_wired *wired = dev_get_drvdata(dev);
+	int interval;
 
-	if (!wired->audio_port.dev)
-		return -ENOTSUPP;
+	interval = xone_wired_get_urb_interval(wired,
+					wired->data_port.ep_in->bInterval);
+	if (!interval)
+		return -EINVAL;
 
-	intf = to_usb_interface(wired->audio_port.dev);
-	if (intf->cur_altsetting->desc.bAlternateSetting == 1)
-		return -EALREADY;
+	/* frames are 1 ms for full speed, microframes 125 μs otherwise */
+	if (wired->udev->speed >= USB_SPEED_HIGH)
+		return sprintf(buf, "%d\n", 8000 / interval);
 
-	return usb_set_interface(wired->udev, XONE_WIRED_INTF_AUDIO, 1);
+	return sprintf(buf, "%d\n", 1000 / interval);
 }
 
-static int xone_wired_init_audio_in(struct gip_adapter *adap)
+static ssize_t audio_gaps_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
 {
-	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
-	struct xone_wired_port *port = &wired->audio_port;
-	struct urb *urb;
-	void *buf;
-	int len, i;
+	struct xone_wired *wired = dev_get_drvdata(dev);
 
-	if (!port->ep_in)
-		return -ENOTSUPP;
+	return sprintf(buf, "%u\n", READ_ONCE(wired->audio_gaps));
+}
 
-	urb = usb_alloc_urb(XONE_WIRED_NUM_AUDIO_PKTS, GFP_KERNEL);
-	if (!urb)
-		return -ENOMEM;
+static ssize_t audio_errors_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct xone_wired *wired = dev_get_drvdata(dev);
 
-	port->urb_in = urb;
+	return sprintf(buf, "%u\n", READ_ONCE(wired->audio_errors));
+}
 
-	len = usb_endpoint_maxp(port->ep_in);
-	buf = usb_alloc_coherent(wired->udev, len * XONE_WIRED_NUM_AUDIO_PKTS,
-				 GFP_KERNEL, &urb->transfer_dma);
-	if (!buf)
-		return -ENOMEM;
+static ssize_t audio_depth_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct xone_wired *wired = dev_get_drvdata(dev);
 
-	urb->dev = wired->udev;
-	urb->pipe = usb_rcvisocpipe(wired->udev, port->ep_in->bEndpointAddress);
-	urb->transfer_flags = URB_ISO_ASAP | URB_NO_TRANSFER_DMA_MAP;
-	urb->transfer_buffer = buf;
-	urb->transfer_buffer_length = len * XONE_WIRED_NUM_AUDIO_PKTS;
-	urb->number_of_packets = XONE_WIRED_NUM_AUDIO_PKTS;
-	urb->interval = port->ep_in->bInterval;
-	urb->context = wired;
-	urb->complete = xone_wired_complete_audio_in;
+	return sprintf(buf, "%d\n", READ_ONCE(wired->adapter->audio_depth));
+}
 
-	for (i = 0; i < XONE_WIRED_NUM_AUDIO_PKTS; i++) {
-		urb->iso_frame_desc[i].offset = i * len;
-		urb->iso_frame_desc[i].length = len;
-	}
+static ssize_t audio_underruns_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct xone_wired *wired = dev_get_drvdata(dev);
 
-	return usb_submit_urb(urb, GFP_KERNEL);
+	return sprintf(buf, "%u\n", READ_ONCE(wired->audio_underruns));
 }
 
-static int xone_wired_init_audio_out(struct gip_adapter *adap, int pkt_len)
+static ssize_t audio_overruns_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
 {
-	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
-	struct xone_wired_port *port = &wired->audio_port;
-	struct urb *urb;
-	void *buf;
-	int i, j;
+	struct xone_wired *wired = dev_get_drvdata(dev);
 
-	if (!port->ep_out)
-		return -ENOTSUPP;
+	return sprintf(buf, "%u\n", READ_ONCE(wired->audio_overruns));
+}
 
-	port->buffer_length_out = pkt_len * XONE_WIRED_NUM_AUDIO_PKTS;
+static ssize_t rx_budget_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct xone_wired *wired = dev_get_drvdata(dev);
 
-	for (i = 0; i < XONE_WIRED_NUM_AUDIO_URBS; i++) {
-		urb = usb_alloc_urb(XONE_WIRED_NUM_AUDIO_PKTS, GFP_KERNEL);
-		if (!urb)
-			return -ENOMEM;
+	return sprintf(buf, "%d\n", READ_ONCE(wired->rx_budget));
+}
 
-		usb_anchor_urb(urb, &port->urbs_out_idle);
-		usb_free_urb(urb);
+static ssize_t rx_budget_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct xone_wired *wired = dev_get_drvdata(dev);
+	unsigned int budget;
+	int err;
 
-		buf = usb_alloc_coherent(wired->udev, port->buffer_length_out,
-					 GFP_KERNEL, &urb->transfer_dma);
-		if (!buf)
-			return -ENOMEM;
+	err = kstrtouint(buf, 10, &budget);
+	if (err)
+		return err;
 
-		urb->dev = wired->udev;
-		urb->pipe = usb_sndisocpipe(wired->udev,
-					    port->ep_out->bEndpointAddress);
-		urb->transfer_flags = URB_ISO_ASAP | URB_NO_TRANSFER_DMA_MAP;
-		urb->transfer_buffer = buf;
-		urb->transfer_buffer_length = port->buffer_length_out;
-		urb->number_of_packets = XONE_WIRED_NUM_AUDIO_PKTS;
-		urb->interval = port->ep_out->bInterval;
-		urb->context = port;
-		urb->complete = xone_wired_complete_out;
+	if (budget > XONE_WIRED_MAX_RX_BUDGET)
+		return -EINVAL;
 
-		for (j = 0; j < XONE_WIRED_NUM_AUDIO_PKTS; j++) {
-			urb->iso_frame_desc[j].offset = j * pkt_len;
-			urb->iso_frame_desc[j].length = pkt_len;
-		}
-	}
+	WRITE_ONCE(wired->rx_budget, budget);
 
-	return 0;
+	return count;
 }
 
-static int xone_wired_disable_audio(struct gip_adapter *adap)
+static ssize_t rx_cpu_show(struct device *dev,
+			   struct device_attribute *attr, char *buf)
 {
-	struct xone_wired *wired = dev_get_drvdata(&adap->dev);
-	struct xone_wired_port *port = &wired->audio_port;
-	struct usb_interface *intf;
+	struct xone_wired *wired = dev_get_drvdata(dev);
 
-	if (!port->dev)
-		return -ENOTSUPP;
+	return sprintf(buf, "%d\n", READ_ONCE(wired->rx_cpu));
+}
 
-	intf = to_usb_interface(port->dev);
-	if (!intf->cur_altsetting->desc.bAlternateSetting)
-		return -EALREADY;
+static ssize_t rx_cpu_store(struct device *dev,
+			    struct device_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct xone_wired *wired = dev_get_drvdata(dev);
+	int cpu, err;
 
-	usb_kill_urb(port->urb_in);
-	usb_kill_anchored_urbs(&port->urbs_out_busy);
-	xone_wired_free_urbs(port);
+	err = kstrtoint(buf, 10, &cpu);
+	if (err)
+		return err;
 
-	return usb_set_interface(wired->udev, XONE_WIRED_INTF_AUDIO, 0);
+	if (cpu < -1 || cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	WRITE_ONCE(wired->rx_cpu, cpu);
+
+	return count;
 }
 
-static struct gip_adapter_ops xone_wired_adapter_ops = {
-	.get_buffer = xone_wired_get_buffer,
-	.submit_buffer = xone_wired_submit_buffer,
-	.enable_audio = xone_wired_enable_audio,
-	.init_audio_in = xone_wired_init_audio_in,
-	.init_audio_out = xone_wired_init_audio_out,
-	.disable_audio = xone_wired_disable_audio,
+static DEVICE_ATTR_RW(poll_interval);
+static DEVICE_ATTR_RO(poll_rate);
+static DEVICE_ATTR_RO(audio_gaps);
+static DEVICE_ATTR_RO(audio_errors);
+static DEVICE_ATTR_RO(audio_depth);
+static DEVICE_ATTR_RO(audio_underruns);
+static DEVICE_ATTR_RO(audio_overruns);
+static DEVICE_ATTR_RW(rx_budget);
+static DEVICE_ATTR_RW(rx_cpu);
+
+static struct attribute *xone_wired_attrs[] = {
+	&dev_attr_poll_interval.attr,
+	&dev_attr_poll_rate.attr,
+	&dev_attr_audio_gaps.attr,
+	&dev_attr_audio_errors.attr,
+	&dev_attr_audio_depth.attr,
+	&dev_attr_audio_underruns.attr,
+	&dev_attr_audio_overruns.attr,
+	&dev_attr_rx_budget.attr,
+	&dev_attr_rx_cpu.attr,
+	NULL,
 };
+ATTRIBUTE_GROUPS(xone_wired);
 
 static struct usb_driver xone_wired_driver;
 
@@ -420,6 +1269,8 @@ static int xone_wired_init_data_port(struct xone_wired *wired,
 	struct xone_wired_port *port = &wired->data_port;
 	int err;
 
+	init_usb_anchor(&port->urbs_in_idle);
+	init_usb_anchor(&port->urbs_in_busy);
 	init_usb_anchor(&port->urbs_out_idle);
 	init_usb_anchor(&port->urbs_out_busy);
 
@@ -440,6 +1291,8 @@ static int xone_wired_init_audio_port(struct xone_wired *wired)
 	struct usb_host_interface *alt;
 	int err;
 
+	init_usb_anchor(&port->urbs_in_idle);
+	init_usb_anchor(&port->urbs_in_busy);
 	init_usb_anchor(&port->urbs_out_idle);
 	init_usb_anchor(&port->urbs_out_busy);
 
@@ -483,6 +1336,16 @@ static int xone_wired_probe(struct usb_interface *intf,
 		return -ENOMEM;
 
 	wired->udev = interface_to_usbdev(intf);
+	spin_lock_init(&wired->tx_lock);
+	init_usb_anchor(&wired->urbs_out_deferred);
+	init_usb_anchor(&wired->urbs_audio_out);
+	INIT_WORK(&wired->waker, xone_wired_wake_up);
+	init_usb_anchor(&wired->urbs_in_done);
+	INIT_WORK(&wired->rx_work, xone_wired_process_rx);
+	wired->rx_budget = min_t(uint, xone_wired_rx_budget,
+				 XONE_WIRED_MAX_RX_BUDGET);
+	wired->rx_cpu = xone_wired_rx_cpu;
+	mutex_init(&wired->poll_lock);
 
 	/* newer devices require a reset after system sleep */
 	usb_reset_device(wired->udev);
@@ -502,23 +1365,58 @@ static int xone_wired_probe(struct usb_interface *intf,
 
 	dev_set_drvdata(&wired->adapter->dev, wired);
 
+	err = xone_wired_init_interval(wired);
+	if (err)
+		goto err_destroy_adapter;
+
+	err = xone_wired_init_dma(wired);
+	if (err)
+		goto err_destroy_adapter;
+
 	err = xone_wired_init_data_out(wired);
 	if (err)
 		goto err_free_urbs;
 
+	err = xone_wired_init_audio_urbs(wired);
+	if (err)
+		goto err_free_urbs;
+
 	err = xone_wired_init_data_in(wired);
 	if (err)
 		goto err_free_urbs;
 
 	usb_set_intfdata(intf, wired);
 
-	/* enable USB remote wakeup */
-	device_wakeup_enable(&wired->udev->dev);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
+	/* added by the driver core on newer kernels */
+	err = sysfs_create_groups(&intf->dev.kobj, xone_wired_groups);
+	if (err) {
+		usb_set_intfdata(intf, NULL);
+		goto err_free_urbs;
+	}
+#endif
+
+	/* enable USB remote wakeup and autosuspend */
+	intf->needs_remote_wakeup = true;
+
+	/* keep changes of the user across rebinds */
+	if (!device_may_wakeup(&wired->udev->dev)) {
+		device_wakeup_enable(&wired->udev->dev);
+		pm_runtime_set_autosuspend_delay(&wired->udev->dev,
+						 XONE_WIRED_SUSPEND_DELAY);
+		usb_enable_autosuspend(wired->udev);
+	}
 
 	return 0;
 
 err_free_urbs:
+	xone_wired_stop_rx(wired);
 	xone_wired_free_urbs(&wired->data_port);
+	xone_wired_free_urbs(&wired->audio_port);
+	xone_wired_free_audio_out(wired);
+	xone_wired_free_dma(wired);
+err_destroy_adapter:
+	xone_wired_restore_interval(wired);
 	gip_destroy_adapter(wired->adapter);
 
 	return err;
@@ -532,18 +1430,105 @@ static void xone_wired_disconnect(struct usb_interface *intf)
 	if (!wired)
 		return;
 
-	usb_kill_urb(wired->data_port.urb_in);
-	usb_kill_urb(wired->audio_port.urb_in);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
+	sysfs_remove_groups(&intf->dev.kobj, xone_wired_groups);
+#endif
+
+	xone_wired_stop_rx(wired);
+	usb_kill_anchored_urbs(&wired->audio_port.urbs_in_busy);
 
 	/* also disables the audio interface */
 	gip_destroy_adapter(wired->adapter);
+	cancel_work_sync(&wired->waker);
 
 	usb_kill_anchored_urbs(&wired->data_port.urbs_out_busy);
+	xone_wired_drop_deferred(wired);
 	xone_wired_free_urbs(&wired->data_port);
+	xone_wired_free_urbs(&wired->audio_port);
+	xone_wired_free_audio_out(wired);
+	xone_wired_free_dma(wired);
+
+	xone_wired_restore_interval(wired);
+	mutex_destroy(&wired->poll_lock);
 
 	usb_set_intfdata(intf, NULL);
 }
 
+static int xone_wired_suspend(struct usb_interface *intf, pm_message_t message)
+{
+	struct xone_wired *wired = usb_get_intfdata(intf);
+	struct xone_wired_port *data, *audio;
+
+	/* ignore audio interface */
+	if (!wired)
+		return 0;
+
+	data = &wired->data_port;
+	audio = &wired->audio_port;
+
+	/* output is submitted under the same lock */
+	spin_lock_irq(&wired->tx_lock);
+
+	/* pending output prevents autosuspend */
+	if (PMSG_IS_AUTO(message) &&
+	    (!usb_anchor_empty(&data->urbs_out_busy) ||
+	     !usb_anchor_empty(&audio->urbs_out_busy))) {
+		spin_unlock_irq(&wired->tx_lock);
+		return -EBUSY;
+	}
+
+	wired->suspended = true;
+	spin_unlock_irq(&wired->tx_lock);
+
+	xone_wired_stop_rx(wired);
+	usb_kill_anchored_urbs(&data->urbs_out_busy);
+	usb_kill_anchored_urbs(&audio->urbs_in_busy);
+	usb_kill_anchored_urbs(&audio->urbs_out_busy);
+
+	if (PMSG_IS_AUTO(message))
+		return 0;
+
+	/*
+	 * Newer devices require a reset after system sleep.
+	 * Skipping resume makes the USB core rebind both interfaces,
+	 * probe then resets the device as it did without PM support.
+	 */
+	intf->needs_binding = 1;
+	if (audio->dev)
+		to_usb_interface(audio->dev)->needs_binding = 1;
+
+	return 0;
+}
+
+static int xone_wired_resume(struct usb_interface *intf)
+{
+	struct xone_wired *wired = usb_get_intfdata(intf);
+	int err;
+
+	/* ignore audio interface */
+	if (!wired)
+		return 0;
+
+	spin_lock_irq(&wired->tx_lock);
+	wired->suspended = false;
+
+	/* sent by xone_wired_start_tx otherwise */
+	if (!wired->tx_stopped)
+		xone_wired_submit_deferred(wired);
+
+	spin_unlock_irq(&wired->tx_lock);
+
+	err = xone_wired_submit_data_in(wired);
+	if (err)
+		return err;
+
+	/* alternate setting is restored by the USB core */
+	if (wired->audio_in_active)
+		return xone_wired_submit_audio_in(wired);
+
+	return 0;
+}
+
 static const struct usb_device_id xone_wired_id_table[] = {
 	{ XONE_WIRED_VENDOR(0x045e) }, /* Microsoft */
 	{ XONE_WIRED_VENDOR(0x0738) }, /* Mad Catz */
@@ -566,7 +1551,14 @@ static struct usb_driver xone_wired_driver = {
 	.name = "xone-wired",
 	.probe = xone_wired_probe,
 	.disconnect = xone_wired_disconnect,
+	.suspend = xone_wired_suspend,
+	.resume = xone_wired_resume,
+	.reset_resume = xone_wired_resume,
 	.id_table = xone_wired_id_table,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+	.dev_groups = xone_wired_groups,
+#endif
+	.supports_autosuspend = true,
 };
 
 module_usb_driver(xone_wired_driver);